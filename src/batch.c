@@ -0,0 +1,82 @@
+#include "checkpoint.h"
+
+
+/// @brief Fills in the same parameters the command line game uses
+/// @param params pointer to a params struct
+void batchParamsDefault(mind_params_t *params) {
+    *params = (mind_params_t) {
+        .n_players = MIND_N_PLAYERS,
+        .max_levels = 0,
+        .time_scale = 1.0F,
+        .shuffle_mode = MIND_SHUFFLE_MODE,
+        .skip_above = 1.0F,
+        .skip_sample = 0.0F
+    };
+    return;
+}
+
+/// @brief Creates a batch handle and its players' threads. This is the only place where memory is allocated
+/// @param batch pointer to a batch struct. The shallow memory of the batch struct is managed by the caller
+/// @param params the parameters every game of the batch is played with (copied)
+void batchCreate(mind_batch_t *batch, const mind_params_t *params) {
+    batch->params = *params;
+    gameCreate(&batch->game, params->n_players);
+
+    batch->game.shuffle_mode = params->shuffle_mode;
+    batch->game.time_scale = params->time_scale;
+    batch->game.max_levels = params->max_levels;
+    batch->game.skip_above = params->skip_above;
+    batch->game.skip_sample = params->skip_sample;
+    batch->game.results = params->results;
+    batch->game.checkpoint = params->checkpoint;
+    gamePoolStart(&batch->game);
+    return;
+}
+
+/// @brief Stops the players' threads and frees everything batchCreate allocated. The params' results file is the caller's to close
+/// @param batch pointer to a batch struct
+void batchDestroy(mind_batch_t *batch) {
+    gameDestroy(&batch->game);
+    return;
+}
+
+/// @brief Plays games first_game .. first_game + n_games - 1 of the batch 'seed', one after the other.
+///        A game the params' checkpoint holds is resumed from its last saved level instead of starting over
+/// @param batch pointer to a batch struct
+/// @param seed the batch's seed
+/// @param first_game index of the first game to play (see batchGameSeed)
+/// @param n_games the number of games to play
+/// @param results caller owned array of at least n_games results
+void batchRun(mind_batch_t *batch, uint64_t seed, uint64_t first_game, uint32_t n_games, mind_game_result_t *results) {
+    game_t *game = &batch->game;
+
+    for (uint32_t i = 0; i < n_games; i++) {
+        uint64_t i_game = first_game + i;
+        if (game->checkpoint == NULL || !checkpointLoadGame(game->checkpoint, game, i_game)) {
+            gameReset(game, batchGameSeed(seed, i_game));
+        }
+        if (game->checkpoint != NULL) {
+            game->checkpoint->i_game = i_game;
+        }
+        gamePlay(game);
+
+        results[i] = (mind_game_result_t) {
+            .seed = game->seed,
+            .n_levels_played = game->n_levels_played,
+            .n_levels_won = game->n_levels_won,
+            .best_level = game->best_level,
+            .won = game->won
+        };
+    }
+    return;
+}
+
+/// @brief The seed of a batch's i-th game, so any game can be replayed (or resumed) on its own
+/// @param seed the batch's seed
+/// @param i_game the game's index within the batch
+/// @return the game's seed
+uint64_t batchGameSeed(uint64_t seed, uint64_t i_game) {
+    uint64_t state = seed;
+    state = splitMix64(&state) + i_game; // mixed first, so neighbouring batch seeds don't share games
+    return splitMix64(&state);
+}
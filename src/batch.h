@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mind.h"
+
+// Embeddable batch simulation: no stdout, no global state and no allocations after batchCreate, which also starts the
+// players' threads (one per player, reused by every game of the batch).
+// A game's players (skill, beat) and its first deal are determined by (seed, game index), so batches can be split up
+// any way the caller likes. How it plays out is not: the players are threads, and the OS' scheduling decides who acts
+// first and so what everyone draws from their rngs next. Batches with the same seed agree in distribution only.
+
+// Parameters shared by every game of a batch
+typedef struct mind_params_t {
+    uint16_t n_players;             // 1 to MIND_MAX_PLAYERS (gameCreate panics otherwise)
+    uint32_t max_levels;            // a game is abandoned after this many levels (0 = play until won)
+    float time_scale;               // multiplies every beat's sleep (1 = real time, 0 = as fast as possible)
+    mind_shuffle_mode_t shuffle_mode;
+    float skip_above;               // levels evaluateLevel rates above this are decided by a coin flip (1 = play them all)
+    float skip_sample;              // the share of those that is played out anyway and weighted up (0 = none, see level.weight)
+    results_t *results;             // optional and caller owned. Every level of every game is appended to it
+    checkpoint_t *checkpoint;       // optional and caller owned. Games are saved to it between levels and resumed from it
+} mind_params_t;
+
+// The outcome of one game, written straight into the caller's array
+typedef struct mind_game_result_t {
+    uint64_t seed;
+    uint32_t n_levels_played;
+    uint32_t n_levels_won;
+    uint16_t best_level;            // highest level won (0 if none)
+    bool won;
+    bool failed;                    // the game kept crashing its worker process and was given up on (see supervisor.h)
+} mind_game_result_t;
+
+typedef struct mind_batch_t {
+    game_t game;
+    mind_params_t params;
+} mind_batch_t;
+
+void batchParamsDefault(mind_params_t *params);
+void batchCreate(mind_batch_t *batch, const mind_params_t *params);
+void batchDestroy(mind_batch_t *batch);
+void batchRun(mind_batch_t *batch, uint64_t seed, uint64_t first_game, uint32_t n_games, mind_game_result_t *results);
+uint64_t batchGameSeed(uint64_t seed, uint64_t i_game);
@@ -0,0 +1,279 @@
+#include "batch.h"
+
+#define BENCH_N_REPEATS (5)         // every metric keeps its best run, which is the least noisy one
+#define BENCH_N_GAMES (16)
+#define BENCH_MAX_LEVELS (24)
+#define BENCH_N_DEALS (20000)
+#define BENCH_N_STACK_OPS (1000000)
+#define BENCH_N_BEATS (20)
+#define BENCH_NAME_LEN (32)
+
+typedef struct bench_metric_t {
+    const char *name;
+    const char *unit;
+    bool higher_is_better;
+    bool gated;             // --check fails on it. Metrics at the OS' mercy (thread scheduling, timer slack) are only shown
+    bool sleeps;            // mostly measures sleeping, which profiling has nothing to learn from (--train skips it)
+    double threshold;       // % worse than the baseline that counts as a regression (gated metrics only)
+    double (*run)(void);
+    double value;
+} bench_metric_t;
+
+double benchGamesPerSecond(void);
+double benchPlayTurn(void);
+double benchStackMoveN(void);
+double benchStackPushN(void);
+double benchDeal(void);
+double benchBeatJitter(void);
+void benchReturnCards(game_t *game);
+bool benchSave(bench_metric_t *metrics, uint32_t n, const char *path);
+bool benchCheck(bench_metric_t *metrics, uint32_t n, const char *path);
+
+static volatile uint64_t bench_sink; // keeps the stack benchmarks from being optimized away (LTO sees through them)
+
+
+/// @brief Measures the simulation's hot paths. Baselines are per machine and per build variant (see the Makefile)
+/// @param argc 1 to 3
+/// @param argv optionally --save <baseline file>, --check <baseline file> or --train (a profiling run, see the Makefile)
+/// @return 1 if --check found a gated metric that regressed past its threshold
+int main(int argc, char **argv) {
+    bench_metric_t metrics[] = {
+        {"games_per_s",    "games/s", true,  false, false, 15.0, benchGamesPerSecond},
+        {"play_turn",      "ns",      false, true,  false, 15.0, benchPlayTurn},
+        {"stack_move_n",   "ns",      false, true,  false, 10.0, benchStackMoveN},
+        {"stack_push_n",   "ns",      false, true,  false, 10.0, benchStackPushN},
+        {"deal",           "ns",      false, true,  false, 15.0, benchDeal},
+        {"beat_jitter",    "us",      false, false, true,  50.0, benchBeatJitter},
+    };
+    const uint32_t n_metrics = sizeof(metrics) / sizeof(metrics[0]);
+
+    bool save = argc == 3 && !strcmp(argv[1], "--save");
+    bool check = argc == 3 && !strcmp(argv[1], "--check");
+    bool train = argc == 2 && !strcmp(argv[1], "--train");
+    if (argc != 1 && !save && !check && !train) {
+        fprintf(stderr, "usage: %s [--save <baseline file> | --check <baseline file> | --train]\n", argv[0]);
+        return 1;
+    }
+
+    for (bench_metric_t *metric = metrics; metric < metrics + n_metrics; metric++) {
+        if (train && metric->sleeps) continue;
+        for (uint32_t i = 0; i < BENCH_N_REPEATS; i++) {
+            double value = metric->run();
+            bool better = (metric->higher_is_better)? value > metric->value: value < metric->value;
+            metric->value = (i == 0 || better)? value: metric->value;
+        }
+        printf("%-16s %14.2f %s\n", metric->name, metric->value, metric->unit);
+        fflush(stdout);
+    }
+
+    if (save) {
+        return !benchSave(metrics, n_metrics, argv[2]);
+    }
+    if (check) {
+        return !benchCheck(metrics, n_metrics, argv[2]);
+    }
+    return 0;
+}
+
+
+//---------------------------------//
+//-----------BENCHMARKS------------//
+//---------------------------------//
+
+/// @brief End to end: a batch of threaded games as fast as they can go
+/// @return games per second
+double benchGamesPerSecond(void) {
+    mind_params_t params;
+    batchParamsDefault(&params);
+    params.time_scale = 0.0F;
+    params.max_levels = BENCH_MAX_LEVELS;
+
+    mind_batch_t batch;
+    mind_game_result_t results[BENCH_N_GAMES];
+    batchCreate(&batch, &params);
+    uint64_t start = timeNowNs();
+    batchRun(&batch, 1, 0, BENCH_N_GAMES, results);
+    double seconds = (timeNowNs() - start) / 1e9;
+    batchDestroy(&batch);
+    return BENCH_N_GAMES / seconds;
+}
+
+/// @brief playTurn without the threads: players take turns round robin on a single thread, so nothing waits on a lock
+/// @return ns per playTurn call
+double benchPlayTurn(void) {
+    game_t game;
+    gameCreate(&game, MIND_N_PLAYERS);
+    gameReset(&game, 1);
+
+    uint64_t ns = 0, n_turns = 0;
+    for (uint32_t i = 0; i < BENCH_N_DEALS / MIND_MAX_LEVEL; i++) {
+        for (uint8_t n_level = 1; n_level <= MIND_MAX_LEVEL; n_level++) {
+            benchReturnCards(&game);
+            gameLevelSetup(&game, n_level);
+
+            uint64_t start = timeNowNs();
+            bool has_cards = true;
+            while (!game.level.is_over && has_cards) {
+                has_cards = false;
+                for (player_t *player = game.players; player < game.players + game.n_players; player++) {
+                    if (!stackGetSize(&player->hand)) continue;
+                    playTurn(player);
+                    player->count++;
+                    n_turns++;
+                    has_cards = true;
+                }
+            }
+            ns += timeNowNs() - start;
+        }
+    }
+
+    gameDestroy(&game);
+    return (double)ns / n_turns;
+}
+
+/// @brief Moves a level's worth of cards from one stack to another and back
+/// @return ns per stackMoveN call
+double benchStackMoveN(void) {
+    stack_t a, b;
+    stackCreate(&a, MIND_DECK_SIZE);
+    stackCreate(&b, MIND_DECK_SIZE);
+    for (uint8_t i = MIND_DECK_SIZE; i > 0; i--) {
+        stackPush(&a, i);
+    }
+
+    uint64_t start = timeNowNs();
+    for (uint32_t i = 0; i < BENCH_N_STACK_OPS / 2; i++) {
+        stackMoveN(&b, &a, MIND_MAX_LEVEL);
+        stackMoveN(&a, &b, MIND_MAX_LEVEL);
+        bench_sink += *a.cards;
+    }
+    uint64_t ns = timeNowNs() - start;
+
+    stackDestroy(&a);
+    stackDestroy(&b);
+    return (double)ns / BENCH_N_STACK_OPS;
+}
+
+/// @brief Pushes a dealt hand onto an empty stack, like gameLevelSetup does
+/// @return ns per stackPushN call
+double benchStackPushN(void) {
+    stack_t stack;
+    stackCreate(&stack, MIND_DECK_SIZE);
+    uint16_t hand[MIND_MAX_LEVEL];
+    for (uint8_t i = 0; i < MIND_MAX_LEVEL; i++) {
+        hand[i] = MIND_DECK_SIZE - i;
+    }
+
+    uint64_t start = timeNowNs();
+    for (uint32_t i = 0; i < BENCH_N_STACK_OPS; i++) {
+        hand[0] = (uint16_t)i;
+        stackPushN(&stack, hand, MIND_MAX_LEVEL);
+        bench_sink += stack.top[-1];
+        stack.top = stack.cards;
+    }
+    uint64_t ns = timeNowNs() - start;
+
+    stackDestroy(&stack);
+    return (double)ns / BENCH_N_STACK_OPS;
+}
+
+/// @brief gameLevelSetup: shuffle, deal, build the lowest card tree and evaluate the deal
+/// @return ns per deal
+double benchDeal(void) {
+    game_t game;
+    gameCreate(&game, MIND_N_PLAYERS);
+    gameReset(&game, 1);
+
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < BENCH_N_DEALS; i++) {
+        benchReturnCards(&game);
+        uint64_t start = timeNowNs();
+        gameLevelSetup(&game, i % MIND_MAX_LEVEL + 1);
+        ns += timeNowNs() - start;
+    }
+
+    gameDestroy(&game);
+    return (double)ns / BENCH_N_DEALS;
+}
+
+/// @brief How late the real time beat wakes up: sleeps the shortest beat playGame can ask for
+/// @return mean distance from the requested beat in us (oversleeping, mostly)
+double benchBeatJitter(void) {
+    uint64_t late_ns = 0;
+    for (uint32_t i = 0; i < BENCH_N_BEATS; i++) {
+        uint64_t start = timeNowNs();
+        SLEEP(MIND_MIN_BEAT);
+        uint64_t slept_ns = timeNowNs() - start;
+        uint64_t beat_ns = (uint64_t)MIND_MIN_BEAT * 1000000;
+        late_ns += (slept_ns > beat_ns)? slept_ns - beat_ns: beat_ns - slept_ns;
+    }
+    return late_ns / 1000.0 / BENCH_N_BEATS;
+}
+
+
+//---------------------------//
+//-----------UTILS-----------//
+//---------------------------//
+
+/// @brief Puts every hand and the pile back in the deck, like gameLevelNext does between levels
+/// @param game pointer to the game struct
+void benchReturnCards(game_t *game) {
+    for (player_t *player = game->players; player < game->players + game->n_players; player++) {
+        stackMoveN(&game->deck, &player->hand, stackGetSize(&player->hand));
+    }
+    stackMoveN(&game->deck, &game->pile, stackGetSize(&game->pile));
+    return;
+}
+
+/// @brief Writes the metrics out as a baseline: one "name value threshold" line each. Thresholds can be edited by hand
+/// @param metrics the measured metrics
+/// @param n the number of metrics
+/// @param path the baseline file to (over)write
+/// @return false if the file could not be written
+bool benchSave(bench_metric_t *metrics, uint32_t n, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return false;
+    }
+    for (bench_metric_t *metric = metrics; metric < metrics + n; metric++) {
+        fprintf(file, "%s %.4f %.1f\n", metric->name, metric->value, metric->threshold);
+    }
+    fclose(file);
+    printf("baseline saved to %s\n", path);
+    return true;
+}
+
+/// @brief Compares the metrics against a baseline. Metrics the baseline doesn't know are left out, and those that aren't
+///        gated are shown but can't fail
+/// @param metrics the measured metrics
+/// @param n the number of metrics
+/// @param path the baseline file, as written by benchSave
+/// @return false if the baseline is missing or any gated metric is worse than the baseline by more than its threshold
+bool benchCheck(bench_metric_t *metrics, uint32_t n, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Can't open %s (make bench-baseline creates it)\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    char name[BENCH_NAME_LEN];
+    double baseline, threshold;
+    printf("\n%-16s %14s %14s %10s\n", "metric", "baseline", "now", "worse by");
+    while (fscanf(file, "%31s %lf %lf", name, &baseline, &threshold) == 3) {
+        for (bench_metric_t *metric = metrics; metric < metrics + n; metric++) {
+            if (strcmp(metric->name, name)) continue;
+
+            double worse = 100.0 * ((metric->higher_is_better)? baseline - metric->value: metric->value - baseline) / baseline;
+            bool regressed = metric->gated && worse > threshold;
+            ok &= !regressed;
+            printf("%-16s %14.2f %14.2f %9.1f%% %s\n", name, baseline, metric->value, worse,
+                   (!metric->gated)? "(not gated)": (regressed)? "REGRESSED": "ok");
+        }
+    }
+    fclose(file);
+
+    printf("%s\n", (ok)? "no regressions": "performance regression!");
+    return ok;
+}
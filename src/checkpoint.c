@@ -0,0 +1,423 @@
+#include "checkpoint.h"
+#include "results.h"
+
+#define CHECKPOINT_HEADER_SZ (4096)
+
+
+/// @brief Creates a fresh checkpoint for a batch: written under a temporary name, synced, then renamed into place.
+///        The temporary file is locked before anything is written to it, so the lock comes along with the rename
+/// @param checkpoint pointer to a checkpoint struct. The shallow memory of the checkpoint struct is managed by the caller
+/// @param path the checkpoint file to (over)write
+/// @param params the parameters every game of the batch is played with
+/// @param seed the batch's seed
+/// @param n_games the number of games in the batch
+/// @param shard_size the supervisor's shard size (see supervisorCreate)
+/// @param interval_ms how often progress is committed and games are saved, at most
+/// @return false if the file could not be created, or another run holds it or is creating it (errno EWOULDBLOCK)
+bool checkpointCreate(checkpoint_t *checkpoint, const char *path, const mind_params_t *params, uint64_t seed,
+                      uint64_t n_games, uint64_t shard_size, uint32_t interval_ms) {
+    checkpoint_header_t header = {
+        .seed = seed,
+        .n_games = n_games,
+        .shard_size = shard_size,
+        .n_shards = (n_games + shard_size - 1) / shard_size,
+        .max_levels = params->max_levels,
+        .time_scale = params->time_scale,
+        .shuffle_mode = params->shuffle_mode,
+        .skip_above = params->skip_above,
+        .skip_sample = params->skip_sample,
+        .n_players = params->n_players
+    };
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    *checkpoint = (checkpoint_t) {.header = &header, .interval_ms = interval_ms, .last_ns = timeNowNs()};
+    checkpointLayout(checkpoint);
+
+    char tmp_path[0x1000];
+    sprintf_s(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    // no O_TRUNC: the file may be another run's, half way through its own checkpointCreate
+    int fd = open(tmp_path, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    if (flock(fd, LOCK_EX | LOCK_NB)) {
+        close(fd);
+        errno = EWOULDBLOCK;
+        return false;
+    }
+    // a run that created the checkpoint (and renamed its own temporary file) before we got ours still holds it
+    int old_fd = open(path, O_RDWR | O_CLOEXEC);
+    bool held = old_fd >= 0 && flock(old_fd, LOCK_EX | LOCK_NB);
+    if (old_fd >= 0) {
+        close(old_fd);
+    }
+    if (held) {
+        unlink(tmp_path);
+        close(fd);
+        errno = EWOULDBLOCK;
+        return false;
+    }
+
+    void *map = MAP_FAILED;
+    if (!ftruncate(fd, 0) && !ftruncate(fd, checkpoint->size)) {
+        map = checkpointMap(fd, checkpoint->size);
+    }
+    if (map == MAP_FAILED) {
+        unlink(tmp_path);
+        close(fd);
+        return false;
+    }
+
+    checkpoint->map = map;
+    checkpoint->fd = fd;
+    memcpy(checkpoint->map, &header, sizeof(header));
+    checkpointLayout(checkpoint);
+
+    // both copies of everything start out valid: no game played (the file starts out zeroed, stats included), no game in flight
+    for (uint64_t i = 0; i < header.n_shards; i++) {
+        checkpointProgress(checkpoint, 0)->shards[i].next = checkpointProgress(checkpoint, 1)->shards[i].next = i * shard_size;
+        checkpoint_slot_t *slot = (checkpoint_slot_t *)(checkpoint->slots + i * checkpoint->slot_sz);
+        for (uint32_t copy = 0; copy < 2; copy++) {
+            ((checkpoint_game_t *)(slot->copies + copy * checkpoint->game_sz))->i_game = CHECKPOINT_NO_GAME;
+        }
+    }
+
+    msync(checkpoint->map, checkpoint->size, MS_SYNC);
+    if (rename(tmp_path, path)) {
+        checkpointClose(checkpoint);
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Locks and maps an existing checkpoint. Nothing is read or copied up front, so this takes as long as an mmap
+/// @param checkpoint pointer to a checkpoint struct. The shallow memory of the checkpoint struct is managed by the caller
+/// @param path the checkpoint file
+/// @param interval_ms how often progress is committed and games are saved, at most
+/// @return false if there is no checkpoint at path (or it isn't one), or another run holds it (errno EWOULDBLOCK)
+bool checkpointResume(checkpoint_t *checkpoint, const char *path, uint32_t interval_ms) {
+    *checkpoint = (checkpoint_t) {.interval_ms = interval_ms, .last_ns = timeNowNs()};
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+    if (flock(fd, LOCK_EX | LOCK_NB)) {
+        close(fd);
+        errno = EWOULDBLOCK;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < CHECKPOINT_HEADER_SZ) {
+        close(fd);
+        return false;
+    }
+
+    void *map = checkpointMap(fd, st.st_size);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    checkpoint->map = map;
+    checkpoint->header = map;
+    if (memcmp(checkpoint->header->magic, CHECKPOINT_MAGIC, sizeof(checkpoint->header->magic))) {
+        munmap(map, st.st_size);
+        close(fd);
+        *checkpoint = (checkpoint_t) {0};
+        return false;
+    }
+    checkpointLayout(checkpoint);
+    if (checkpoint->size != (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        close(fd);
+        *checkpoint = (checkpoint_t) {0};
+        return false;
+    }
+    checkpoint->fd = fd;
+    return true;
+}
+
+/// @brief Unmaps the checkpoint and releases the lock on it. Whatever wasn't committed is left for the next resume to ignore
+/// @param checkpoint pointer to a checkpoint struct
+void checkpointClose(checkpoint_t *checkpoint) {
+    if (checkpoint->map != NULL) {
+        munmap(checkpoint->map, checkpoint->size);
+        close(checkpoint->fd); // the lock goes with it: the workers close their copies when they start, and the map has its own
+    }
+    *checkpoint = (checkpoint_t) {0};
+    return;
+}
+
+/// @brief The parameters the checkpoint's batch was started with, so a resumed run plays exactly the same games
+/// @param checkpoint pointer to a checkpoint struct
+/// @param params filled in. Its checkpoint is this one, its results file is left unset
+void checkpointParams(checkpoint_t *checkpoint, mind_params_t *params) {
+    checkpoint_header_t *header = checkpoint->header;
+
+    batchParamsDefault(params);
+    params->n_players = header->n_players;
+    params->max_levels = header->max_levels;
+    params->time_scale = header->time_scale;
+    params->shuffle_mode = header->shuffle_mode;
+    params->skip_above = header->skip_above;
+    params->skip_sample = header->skip_sample;
+    params->checkpoint = checkpoint;
+    return;
+}
+
+
+//---------------------------------//
+//------------PROGRESS-------------//
+//---------------------------------//
+
+/// @brief The first game of a shard that wasn't reported as of the last commit
+/// @param checkpoint pointer to a checkpoint struct
+/// @param i_shard the shard
+/// @return the game's index. Games before it have their results in checkpoint->results
+uint64_t checkpointNext(checkpoint_t *checkpoint, uint64_t i_shard) {
+    uint64_t generation = atomic_load(&checkpoint->header->generation);
+    return checkpointProgress(checkpoint, generation & 1)->shards[i_shard].next;
+}
+
+/// @brief The size of a shard's results file as of the last commit: what it holds of the games before checkpointNext
+/// @param checkpoint pointer to a checkpoint struct
+/// @param i_shard the shard
+/// @return the size, 0 if the shard had no results file yet
+uint64_t checkpointResultsSize(checkpoint_t *checkpoint, uint64_t i_shard) {
+    uint64_t generation = atomic_load(&checkpoint->header->generation);
+    return checkpointProgress(checkpoint, generation & 1)->shards[i_shard].results_size;
+}
+
+/// @brief The stats of every game that was reported as of the last commit
+/// @param checkpoint pointer to a checkpoint struct
+/// @return per level number, MIND_MAX_LEVEL + 1 of them
+const mind_stats_t *checkpointStats(checkpoint_t *checkpoint) {
+    uint64_t generation = atomic_load(&checkpoint->header->generation);
+    return checkpointProgress(checkpoint, generation & 1)->stats;
+}
+
+/// @brief Records a shard's progress in the copy the next commit will make current. Stage every shard before committing
+/// @param checkpoint pointer to a checkpoint struct
+/// @param i_shard the shard
+/// @param next the first game of the shard that hasn't been reported yet
+/// @param results_size the size of the shard's results file after the games before next
+void checkpointStage(checkpoint_t *checkpoint, uint64_t i_shard, uint64_t next, uint64_t results_size) {
+    uint64_t generation = atomic_load(&checkpoint->header->generation);
+    checkpoint_shard_t *shard = &checkpointProgress(checkpoint, (generation + 1) & 1)->shards[i_shard];
+    shard->next = next;
+    shard->results_size = results_size;
+    return;
+}
+
+/// @brief Makes the staged progress current: results and staged progress hit the disk first, the generation flip last
+/// @param checkpoint pointer to a checkpoint struct
+/// @param stats of every game the staged progress has as reported (MIND_MAX_LEVEL + 1), committed along with it
+void checkpointCommit(checkpoint_t *checkpoint, const mind_stats_t *stats) {
+    uint64_t generation = atomic_load(&checkpoint->header->generation);
+    memcpy(checkpointProgress(checkpoint, (generation + 1) & 1)->stats, stats, sizeof(mind_stats_t) * (MIND_MAX_LEVEL + 1));
+    msync(checkpoint->map, checkpoint->size, MS_SYNC);
+    atomic_fetch_add(&checkpoint->header->generation, 1);
+    checkpointSync(checkpoint, checkpoint->header, sizeof(*checkpoint->header));
+    checkpoint->last_ns = timeNowNs();
+    return;
+}
+
+/// @brief Whether interval_ms has passed since this process last committed or saved a game
+/// @param checkpoint pointer to a checkpoint struct
+/// @return true if it's time for the next one
+bool checkpointDue(checkpoint_t *checkpoint) {
+    return timeNowNs() - checkpoint->last_ns >= checkpoint->interval_ms * 1000000ULL;
+}
+
+
+//---------------------------------//
+//-------------GAMES---------------//
+//---------------------------------//
+
+/// @brief Saves the game checkpoint->i_game into its shard's slot, if one is due. Called by gameLevelNext once the next
+///        level is dealt, while every other player thread waits on the barrier. The game's results file is flushed
+///        first, so that the levels played so far are in it by the size saved
+/// @param checkpoint pointer to a checkpoint struct
+/// @param game pointer to the game struct
+void checkpointSaveGame(checkpoint_t *checkpoint, game_t *game) {
+    if (!checkpointDue(checkpoint)) return;
+
+    checkpoint_slot_t *slot = (checkpoint_slot_t *)(checkpoint->slots + (checkpoint->i_game / checkpoint->header->shard_size) * checkpoint->slot_sz);
+    uint64_t generation = atomic_load(&slot->generation);
+    checkpoint_game_t *saved = (checkpoint_game_t *)(slot->copies + ((generation + 1) & 1) * checkpoint->game_sz);
+
+    saved->i_game = checkpoint->i_game;
+    saved->seed = game->seed;
+    saved->results_size = 0;
+    if (game->results != NULL) {
+        resultsFlush(game->results); // a failure sticks, and fails the game when it's over (see supervisorWorker)
+        saved->results_size = game->results->size;
+    }
+    saved->n_levels_played = game->n_levels_played;
+    saved->n_levels_won = game->n_levels_won;
+    saved->best_level = game->best_level;
+    memcpy(saved->stats, game->stats, sizeof(game->stats));
+    saved->level = game->level;
+    saved->n_deck = stackGetSize(&game->deck);
+    memcpy(saved->players + game->n_players, game->deck.cards, sizeof(*game->deck.cards) * saved->n_deck);
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        player_t *player = &game->players[i];
+        checkpoint_player_t *saved_player = &saved->players[i];
+        saved_player->rng = player->rng;
+        saved_player->skill = player->skill;
+        saved_player->focus = player->focus;
+        saved_player->beat = player->beat;
+        saved_player->count = player->count;
+        memcpy(saved_player->timeout, player->timeout, sizeof(player->timeout));
+        saved_player->pile_card = player->pile_card;
+        saved_player->last_card_played = player->last_card_played;
+        saved_player->threshold = player->threshold;
+        saved_player->n_hand = stackGetSize(&player->hand);
+        memcpy(saved_player->hand, player->hand.cards, sizeof(*player->hand.cards) * saved_player->n_hand);
+    }
+
+    checkpointSync(checkpoint, saved, checkpoint->game_sz);
+    atomic_store(&slot->generation, generation + 1);
+    checkpoint->last_ns = timeNowNs();
+    return;
+}
+
+/// @brief Restores a game from its shard's slot, instead of gameReset. gamePlay then picks it up at the saved level.
+///        The stats of the levels played before the save are added to the game struct's
+/// @param checkpoint pointer to a checkpoint struct
+/// @param game pointer to the game struct
+/// @param i_game the game's index within the batch
+/// @return false if the slot doesn't hold that game (it was never saved, or it was a previous game of the shard)
+bool checkpointLoadGame(checkpoint_t *checkpoint, game_t *game, uint64_t i_game) {
+    checkpoint_slot_t *slot = (checkpoint_slot_t *)(checkpoint->slots + (i_game / checkpoint->header->shard_size) * checkpoint->slot_sz);
+    uint64_t generation = atomic_load(&slot->generation);
+    checkpoint_game_t *saved = (checkpoint_game_t *)(slot->copies + (generation & 1) * checkpoint->game_sz);
+    if (saved->i_game != i_game || game->n_players != checkpoint->header->n_players) return false;
+
+    game->seed = saved->seed;
+    game->won = false;
+    game->n_levels_played = saved->n_levels_played;
+    game->n_levels_won = saved->n_levels_won;
+    game->best_level = saved->best_level;
+    game->level = saved->level;
+    game->level_latency = (mind_latency_t) {0};
+    statsMerge(game->stats, saved->stats);
+    game->deck.top = game->deck.cards;
+    stackPushN(&game->deck, (uint16_t *)(saved->players + game->n_players), saved->n_deck);
+    game->pile.top = game->pile.cards;
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        player_t *player = &game->players[i];
+        checkpoint_player_t *saved_player = &saved->players[i];
+        player->rng = saved_player->rng;
+        player->skill = saved_player->skill;
+        player->focus = saved_player->focus;
+        player->beat = saved_player->beat;
+        player->count = saved_player->count;
+        memcpy(player->timeout, saved_player->timeout, sizeof(player->timeout));
+        player->pile_card = saved_player->pile_card;
+        player->pile_seen = 0; // the pile is empty at a level boundary
+        player->last_card_played = saved_player->last_card_played;
+        player->threshold = saved_player->threshold;
+        player->n = i;
+        player->hand.top = player->hand.cards;
+        stackPushN(&player->hand, saved_player->hand, saved_player->n_hand);
+    }
+    gameLowestBuild(game);
+    return true;
+}
+
+
+/// @brief The size the shard's results file had when a game was saved, which is where a worker that resumes the game has
+///        to cut the file back to
+/// @param checkpoint pointer to a checkpoint struct
+/// @param i_game the game's index within the batch
+/// @param results_size set to the saved size, if the slot holds the game
+/// @return false if the slot doesn't hold that game (checkpointLoadGame would start it over)
+bool checkpointSavedResultsSize(checkpoint_t *checkpoint, uint64_t i_game, uint64_t *results_size) {
+    checkpoint_slot_t *slot = (checkpoint_slot_t *)(checkpoint->slots + (i_game / checkpoint->header->shard_size) * checkpoint->slot_sz);
+    uint64_t generation = atomic_load(&slot->generation);
+    checkpoint_game_t *saved = (checkpoint_game_t *)(slot->copies + (generation & 1) * checkpoint->game_sz);
+    if (saved->i_game != i_game) return false;
+
+    *results_size = saved->results_size;
+    return true;
+}
+
+/// @brief Empties a shard's slot. For a shard that is replayed from before its saved game: the game's levels before the
+///        save were cut from the results file along with everything after the replay's start, so it has to start over too
+/// @param checkpoint pointer to a checkpoint struct
+/// @param i_shard the shard
+void checkpointDropGame(checkpoint_t *checkpoint, uint64_t i_shard) {
+    checkpoint_slot_t *slot = (checkpoint_slot_t *)(checkpoint->slots + i_shard * checkpoint->slot_sz);
+    uint64_t generation = atomic_load(&slot->generation);
+    if (((checkpoint_game_t *)(slot->copies + (generation & 1) * checkpoint->game_sz))->i_game == CHECKPOINT_NO_GAME) return;
+
+    checkpoint_game_t *saved = (checkpoint_game_t *)(slot->copies + ((generation + 1) & 1) * checkpoint->game_sz);
+    saved->i_game = CHECKPOINT_NO_GAME;
+    checkpointSync(checkpoint, saved, sizeof(*saved));
+    atomic_store(&slot->generation, generation + 1);
+    return;
+}
+
+
+//---------------------------//
+//-----------UTILS-----------//
+//---------------------------//
+
+/// @brief Works out where everything is from the header: sizes, then (if the file is mapped) pointers
+/// @param checkpoint pointer to a checkpoint struct whose header is set
+void checkpointLayout(checkpoint_t *checkpoint) {
+    checkpoint_header_t *header = checkpoint->header;
+    checkpoint->progress_sz = sizeof(checkpoint_progress_t) + sizeof(checkpoint_shard_t) * header->n_shards;
+    checkpoint->progress_sz = (checkpoint->progress_sz + CHECKPOINT_ALIGN - 1) & ~(size_t)(CHECKPOINT_ALIGN - 1);
+    size_t results_sz = sizeof(mind_game_result_t) * header->n_games;
+    size_t results_offset = CHECKPOINT_HEADER_SZ + 2 * checkpoint->progress_sz;
+    size_t slots_offset = (results_offset + results_sz + CHECKPOINT_ALIGN - 1) & ~(size_t)(CHECKPOINT_ALIGN - 1);
+
+    checkpoint->game_sz = sizeof(checkpoint_game_t) + sizeof(checkpoint_player_t) * header->n_players +
+                          sizeof(uint16_t) * gameDeckSize(header->n_players);
+    checkpoint->game_sz = (checkpoint->game_sz + CHECKPOINT_ALIGN - 1) & ~(size_t)(CHECKPOINT_ALIGN - 1);
+    checkpoint->slot_sz = sizeof(checkpoint_slot_t) + 2 * checkpoint->game_sz;
+    checkpoint->size = slots_offset + checkpoint->slot_sz * header->n_shards;
+
+    if (checkpoint->map != NULL) {
+        checkpoint->header = (checkpoint_header_t *)checkpoint->map;
+        checkpoint->progress = checkpoint->map + CHECKPOINT_HEADER_SZ;
+        checkpoint->results = (mind_game_result_t *)(checkpoint->map + results_offset);
+        checkpoint->slots = checkpoint->map + slots_offset;
+    }
+    return;
+}
+
+/// @brief One of the two copies of the batch's progress
+/// @param checkpoint pointer to a mapped checkpoint struct
+/// @param copy 0 or 1 (the committed one is header->generation & 1)
+/// @return the copy
+checkpoint_progress_t *checkpointProgress(checkpoint_t *checkpoint, uint64_t copy) {
+    return (checkpoint_progress_t *)(checkpoint->progress + copy * checkpoint->progress_sz);
+}
+
+/// @brief Maps a checkpoint file through a descriptor of its own. A map keeps the file it was made from open, and forked
+///        workers inherit the map: made from the locked descriptor, it would keep the lock held until the last of them exits
+/// @param fd the checkpoint's (locked) descriptor
+/// @param size the size to map
+/// @return the map, MAP_FAILED if the file can't be reopened or mapped
+void *checkpointMap(int fd, size_t size) {
+    char path[0x40];
+    sprintf_s(path, sizeof(path), "/proc/self/fd/%d", fd);
+    int map_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (map_fd < 0) return MAP_FAILED;
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd, 0);
+    close(map_fd);
+    return map;
+}
+
+/// @brief msync for a range that doesn't have to start on a page
+/// @param checkpoint pointer to a checkpoint struct
+/// @param addr the range's start, inside the checkpoint's map
+/// @param sz the range's size
+void checkpointSync(checkpoint_t *checkpoint, void *addr, size_t sz) {
+    uintptr_t page_sz = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page_sz - 1);
+    msync((void *)start, (uintptr_t)addr + sz - start, MS_SYNC);
+    return;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "batch.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <errno.h>
+
+#define CHECKPOINT_MAGIC "MINDCKP4"
+#define CHECKPOINT_INTERVAL_MS (1000) // how often progress is committed and an in-flight game is saved, at most
+#define CHECKPOINT_NO_GAME (UINT64_MAX)
+#define CHECKPOINT_ALIGN (64)
+
+// A batch's progress, mapped into memory and shared (MAP_SHARED) with the supervisor's workers. File layout:
+//  - checkpoint_header_t: the batch's parameters, padded to a page
+//  - the batch's progress (checkpoint_progress_t), twice. header->generation & 1 says which copy is the committed one
+//  - the results of every game of the batch. Results before a shard's committed 'next' are final
+//  - one slot per shard: the shard's in-flight game as of its last level boundary, also twice (see checkpoint_slot_t)
+// Nothing is ever overwritten in place: the stale copy is written and msync'd, and only then does the generation flip.
+// A run that is killed at any point resumes from the last flip; the file itself is created under a temporary name
+// and renamed into place, so a half initialized checkpoint is never found either.
+// A checkpoint is written by one run at a time: the run holds an exclusive flock on it for as long as it is open. The
+// forked workers don't (they close the locked descriptor, and the map is made through another one), so the lock is
+// released the moment the run exits. Creating or resuming a checkpoint another run holds fails with errno EWOULDBLOCK.
+
+typedef struct checkpoint_header_t {
+    char magic[8];
+    uint64_t seed;
+    uint64_t n_games;
+    uint64_t shard_size;
+    uint64_t n_shards;
+    uint32_t max_levels;
+    float time_scale;
+    uint32_t shuffle_mode;
+    float skip_above;
+    uint16_t n_players;
+    atomic_uint_least64_t generation;       // of the shards' progress
+    float skip_sample;
+} checkpoint_header_t;
+
+typedef struct checkpoint_shard_t {
+    uint64_t next;                          // the first game of the shard that wasn't reported
+    uint64_t results_size;                  // the shard's results file's size after the games before it (see resultsAppend)
+} checkpoint_shard_t;
+
+// The batch as of a commit: how far every shard got, and the stats of the games that got it there
+typedef struct checkpoint_progress_t {
+    mind_stats_t stats[MIND_MAX_LEVEL + 1]; // of every game reported by the commit
+    checkpoint_shard_t shards[];            // n_shards
+} checkpoint_progress_t;
+
+// What is left of a player at a level boundary. Everything else (thread, game) belongs to the process
+typedef struct checkpoint_player_t {
+    rng_t rng;                              // the stream's state and the unread part of its buffer
+    float skill;
+    float focus;
+    uint32_t beat;
+    uint32_t count;
+    uint32_t timeout[mind_n_player_effects];
+    uint16_t pile_card;
+    uint16_t last_card_played;
+    uint16_t threshold;
+    uint16_t n_hand;
+    uint16_t hand[MIND_MAX_LEVEL];
+} checkpoint_player_t;
+
+// A game right after gameLevelNext dealt its next level: the pile is empty, and the lowest card tree is rebuilt on load
+typedef struct checkpoint_game_t {
+    uint64_t i_game;                        // CHECKPOINT_NO_GAME if the copy is empty
+    uint64_t seed;
+    uint64_t results_size;                  // the shard's results file's size at the save, the game's levels so far included
+    uint32_t n_levels_played;
+    uint32_t n_levels_won;
+    uint16_t best_level;
+    mind_stats_t stats[MIND_MAX_LEVEL + 1]; // the game struct's, which supervisorWorker zeroes before every game
+    struct mind_level_t level;
+    uint16_t n_deck;
+    checkpoint_player_t players[];          // n_players, followed by the deck's n_deck cards (room for gameDeckSize)
+} checkpoint_game_t;
+
+typedef struct checkpoint_slot_t {
+    atomic_uint_least64_t generation;       // generation & 1 is the valid copy
+    uint8_t pad[CHECKPOINT_ALIGN - sizeof(atomic_uint_least64_t)];
+    uint8_t copies[];                       // 2 checkpoint_game_t of checkpoint_t.game_sz bytes each
+} checkpoint_slot_t;
+
+// Per process view of the file
+struct checkpoint_t {
+    uint8_t *map;
+    size_t size;
+    int fd;                                 // held open (and locked) until checkpointClose. Forked workers close it
+    checkpoint_header_t *header;
+    uint8_t *progress;                      // [2], progress_sz bytes each (see checkpointProgress)
+    mind_game_result_t *results;            // [n_games], can be handed straight to supervisorRun
+    uint8_t *slots;                         // [n_shards], slot_sz bytes each
+    size_t progress_sz;
+    size_t game_sz;
+    size_t slot_sz;
+    uint32_t interval_ms;
+    uint64_t last_ns;                       // when this process last committed or saved a game
+    uint64_t i_game;                        // the game this process is playing (set by batchRun)
+};
+
+bool checkpointCreate(checkpoint_t *checkpoint, const char *path, const mind_params_t *params, uint64_t seed,
+                      uint64_t n_games, uint64_t shard_size, uint32_t interval_ms);
+bool checkpointResume(checkpoint_t *checkpoint, const char *path, uint32_t interval_ms);
+void checkpointClose(checkpoint_t *checkpoint);
+void checkpointParams(checkpoint_t *checkpoint, mind_params_t *params);
+uint64_t checkpointNext(checkpoint_t *checkpoint, uint64_t i_shard);
+uint64_t checkpointResultsSize(checkpoint_t *checkpoint, uint64_t i_shard);
+void checkpointStage(checkpoint_t *checkpoint, uint64_t i_shard, uint64_t next, uint64_t results_size);
+void checkpointCommit(checkpoint_t *checkpoint, const mind_stats_t *stats);
+const mind_stats_t *checkpointStats(checkpoint_t *checkpoint);
+bool checkpointDue(checkpoint_t *checkpoint);
+void checkpointSaveGame(checkpoint_t *checkpoint, game_t *game);
+bool checkpointLoadGame(checkpoint_t *checkpoint, game_t *game, uint64_t i_game);
+bool checkpointSavedResultsSize(checkpoint_t *checkpoint, uint64_t i_game, uint64_t *results_size);
+void checkpointDropGame(checkpoint_t *checkpoint, uint64_t i_shard);
+void checkpointLayout(checkpoint_t *checkpoint);
+checkpoint_progress_t *checkpointProgress(checkpoint_t *checkpoint, uint64_t copy);
+void *checkpointMap(int fd, size_t size);
+void checkpointSync(checkpoint_t *checkpoint, void *addr, size_t sz);
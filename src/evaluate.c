@@ -0,0 +1,82 @@
+#include "evaluate.h"
+
+// Gauss-Hermite nodes and weights for E[f(Z)], Z ~ N(0, 1); the rule is symmetric, so each node is used as +z and -z
+static const double nodes[EVALUATE_N_NODES] = {
+    0.386760604500557, 1.163829100554965, 1.951980345716334, 2.760245047630701,
+    3.600873624171548, 4.492955302520011, 5.472225705949343, 6.630878198393129
+};
+static const double weights[EVALUATE_N_NODES] = {
+    2.865685212380121e-01, 1.583383727509494e-01, 4.728475235401400e-02, 7.266937601184741e-03,
+    5.259849265739098e-04, 1.530003216248731e-05, 1.309473216286821e-07, 1.497814723161837e-10
+};
+
+
+/// @brief Probability that the level that was just dealt is won under the idealised counting model (see evaluate.h).
+///        Walks the cards in the only order that wins, multiplying the chances of each card beating everyone else's.
+/// @param game pointer to the game struct, right after the hands were dealt
+/// @return the win probability
+float evaluateLevel(game_t *game) {
+    uint16_t **next = game->evaluate_next; // each player's lowest card that hasn't been played yet (NULL when out of cards)
+    uint32_t n_left = 0;
+
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        stack_t *hand = &game->players[i].hand;
+        next[i] = (stackGetSize(hand))? hand->top - 1: NULL;
+        n_left += stackGetSize(hand);
+    }
+
+    double p_win = 1.0;
+    uint16_t pile_card = 0;
+    while (n_left) {
+        uint16_t i_holder = 0;
+        uint16_t n_holders = 0;
+        for (uint16_t i = 0; i < game->n_players; i++) {
+            if (next[i] == NULL) continue;
+            n_holders++;
+            if (next[i_holder] == NULL || *next[i] < *next[i_holder]) {
+                i_holder = i;
+            }
+        }
+
+        // a player who holds every remaining card can't get it wrong
+        if (n_holders > 1) {
+            p_win *= evaluateStep(game, i_holder, next, pile_card);
+        }
+
+        pile_card = *next[i_holder];
+        next[i_holder] = (next[i_holder] == game->players[i_holder].hand.cards)? NULL: next[i_holder] - 1;
+        n_left--;
+    }
+
+    return (float)p_win;
+}
+
+/// @brief Probability that the holder of the lowest card plays it before anybody else plays theirs
+/// @param game pointer to the game struct
+/// @param i_holder the player holding the lowest card
+/// @param next every player's lowest card (NULL if they have none)
+/// @param pile_card the card everyone's count is synced to
+/// @return P(holder's time < every other player's time)
+double evaluateStep(game_t *game, uint16_t i_holder, uint16_t *const *next, uint16_t pile_card) {
+    player_t *holder = &game->players[i_holder];
+    double t_holder = (double)(*next[i_holder] - pile_card) * holder->beat;
+    double err_holder = playerGetError(holder);
+    double res = 0;
+
+    for (uint8_t k = 0; k < 2 * EVALUATE_N_NODES; k++) {
+        double z = (k & 1)? -nodes[k / 2]: nodes[k / 2];
+        double t = t_holder * fmax(0.0, 1.0 + err_holder * z);
+        double p = weights[k / 2];
+
+        for (uint16_t j = 0; j < game->n_players && p > 0; j++) {
+            if (j == i_holder || next[j] == NULL) continue;
+            player_t *other = &game->players[j];
+            double mean = (double)(*next[j] - pile_card) * other->beat;
+            double sd = mean * playerGetError(other);
+            // P(other's time > t)
+            p *= (sd > 0)? 0.5 * erfc((t - mean) / (sd * M_SQRT2)): (t < mean);
+        }
+        res += p;
+    }
+    return res;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "mind.h"
+
+#define EVALUATE_N_NODES (8) // the positive half of a symmetric 16 point Gauss-Hermite rule
+
+// Win probability of a dealt level under an idealised counting model: every time a card is played, everyone's count
+// syncs to it, and player i would play their lowest card c after (c - pile) * beat_i * (1 + err_i * Z) with Z ~ N(0, 1)
+// and err_i = playerGetError. A level is won if, every time, the lowest card in any hand is the first one played.
+// Status effects, beat adjustments and thread scheduling are left out on purpose: this is the baseline they add to.
+
+float evaluateLevel(game_t *game);
+double evaluateStep(game_t *game, uint16_t i_holder, uint16_t *const *next, uint16_t pile_card);
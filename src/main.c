@@ -0,0 +1,39 @@
+// #include <memdbg/include/memdbg.h>
+#include "mind.h"
+#include "results.h"
+
+
+/// @brief Plays a single game until it's won
+/// @param argc 1 or 2
+/// @param argv optionally, a file to store the outcome of every level in (see results.h)
+int main(int argc, char **argv) {
+#ifdef MIND_VALIDATE_SHUFFLE
+    return !shuffleValidate(20000, ((uint64_t)trueRand() << 32) | trueRand());
+#endif
+    game_t game;
+    gameCreate(&game, MIND_N_PLAYERS);
+    game.verbose = true;
+
+    results_t results;
+    if (argc > 1) {
+        if (!resultsCreate(&results, argv[1], game.n_players)) {
+            fprintf(stderr, "Can't create %s\n", argv[1]);
+            return 1;
+        }
+        game.results = &results;
+    }
+
+    gameReset(&game, ((uint64_t)trueRand() << 32) | trueRand());
+    gamePlay(&game);
+    printf("\n~~~~~~~~~~~~~~~~~~~\n~~~~~GAME WON!~~~~~\n~~~~~~~~~~~~~~~~~~~\n\n");
+    statsLatencyReport(game.stats, stdout);
+    printf("\n");
+    statsEvaluationReport(game.stats, stdout);
+
+    bool written = game.results == NULL || resultsDestroy(game.results);
+    if (!written) {
+        fprintf(stderr, "Can't write %s, it ends with the last block written whole\n", argv[1]);
+    }
+    gameDestroy(&game);
+    return !written;
+}
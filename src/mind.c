@@ -1,24 +1,8 @@
 // #include <memdbg/include/memdbg.h>
 #include "mind.h"
-
-
-int main(void) {
-    srand(trueRand());
-
-    game_t game;
-    gameCreate(&game, MIND_N_PLAYERS);
-
-    for (uint8_t i = 0; i < game.n_players; i++) {
-        THREAD_CREATE(game.players[i].thread, playGame, &game.players[i]);
-    }
-
-    for (uint8_t i = 0; i < game.n_players; i++) {
-        THREAD_JOIN(game.players[i].thread);
-    }
-    printf("\n~~~~~~~~~~~~~~~~~~~\n~~~~~GAME WON!~~~~~\n~~~~~~~~~~~~~~~~~~~\n");
-    gameDestroy(&game);
-    return 0;
-}
+#include "results.h"
+#include "evaluate.h"
+#include "checkpoint.h"
 
 
 //--------------------------------//
@@ -60,7 +44,7 @@ uint32_t stackGetSize(stack_t *stack) {
 /// @brief Adds a card to a stack
 /// @param stack pointer to a stack struct
 /// @param value The added card's value
-void stackPush(stack_t *stack, uint8_t value) {
+void stackPush(stack_t *stack, uint16_t value) {
     stackPushN(stack, &value, 1);
     return;
 }
@@ -68,8 +52,8 @@ void stackPush(stack_t *stack, uint8_t value) {
 /// @brief Removes a card from a stack
 /// @param stack pointer to a stack struct
 /// @return The removed card's value
-uint8_t stackPop(stack_t *stack) {
-    uint8_t res;
+uint16_t stackPop(stack_t *stack) {
+    uint16_t res;
     stackPopN(stack, &res, 1);
     return res;
 }
@@ -86,12 +70,12 @@ void stackMove(stack_t *dst, stack_t *src) {
 /// @param stack pointer to a stack struct
 /// @param values a pointer to an array of values
 /// @param n the number of cards to be added
-void stackPushN(stack_t *stack, uint8_t *values, size_t n) {
+void stackPushN(stack_t *stack, uint16_t *values, size_t n) {
     uint32_t sz = stackGetSize(stack);
     if (sz > (stack->allocd - n)) {
         _threads_api_Panik("Not enough memory!");
     }
-    memcpy_s(stack->top, stack->allocd - sz, values, n);
+    memcpy_s(stack->top, (stack->allocd - sz) * sizeof(*values), values, n * sizeof(*values));
     stack->top += n;
 
     return;
@@ -101,12 +85,12 @@ void stackPushN(stack_t *stack, uint8_t *values, size_t n) {
 /// @param stack pointer to a stack struct
 /// @param res a pointer to an array where the resulting values should be stored
 /// @param n the number of cards to be removed
-void stackPopN(stack_t *stack, uint8_t *res, size_t n) {
+void stackPopN(stack_t *stack, uint16_t *res, size_t n) {
     uint32_t sz = stackGetSize(stack);
     if (sz < n) {
         _threads_api_Panik("Not enough items!");
     }
-    memcpy_s(res, sz, stack->top - n, n);
+    memcpy_s(res, n * sizeof(*res), stack->top - n, n * sizeof(*res));
     stack->top -= n;
 
     return;
@@ -128,7 +112,7 @@ void stackMoveN(stack_t *dst, stack_t *src, size_t n) {
 /// @brief Outputs the top of the stack without removing it from the stack
 /// @param stack pointer to a stack struct
 /// @return the stack's top card
-uint8_t stackPeek(stack_t *stack) {
+uint16_t stackPeek(stack_t *stack) {
     return *(stack->top - 1);
 }
 
@@ -160,20 +144,108 @@ void stackPrint(stack_t *stack, const char *stack_name) {
 }
 
 
+//-------------------------------//
+//------RNG IMPLEMENTATION-------//
+//-------------------------------//
+
+/// @brief Seeds a random stream (no mallocs). The buffers are filled lazily on the first draw
+/// @param rng pointer to an rng struct. The memory is managed by the caller
+/// @param seed any 64 bit value; different seeds give unrelated streams
+void rngCreate(rng_t *rng, uint64_t seed) {
+    for (uint8_t lane = 0; lane < 4; lane++) {
+        rng->s0[lane] = splitMix64(&seed);
+        rng->s1[lane] = splitMix64(&seed) | 1; // xorshift128+ must never have an all-zero state
+    }
+    rng->i = MIND_RNG_BUFFER_SIZE;
+    return;
+}
+
+/// @brief Refills both of the rng's buffers in one go. Each lane is advanced MIND_RNG_BUFFER_SIZE / 4 times.
+///        The AVX2 and scalar versions produce exactly the same values.
+/// @param rng pointer to an rng struct
+void rngRefill(rng_t *rng) {
+    const float to_unit = 1.0F / 16777216.0F; // 24 bits of mantissa -> [0, 1)
+#ifdef __AVX2__
+    __m256i s0 = _mm256_loadu_si256((const __m256i *)rng->s0);
+    __m256i s1 = _mm256_loadu_si256((const __m256i *)rng->s1);
+    const __m256 scale = _mm256_set1_ps(to_unit);
+
+    for (uint32_t i = 0; i < 2 * MIND_RNG_BUFFER_SIZE; i += 8) {
+        __m256i x = s0;
+        __m256i y = s1;
+        s0 = y;
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+        s1 = _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(_mm256_srli_epi64(x, 17), _mm256_srli_epi64(y, 26)));
+        __m256i out = _mm256_add_epi64(s1, y);
+
+        if (i < MIND_RNG_BUFFER_SIZE) {
+            __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(out, 8)), scale);
+            _mm256_storeu_ps(&rng->floats[i], f);
+        } else {
+            _mm256_storeu_si256((__m256i *)&rng->ints[i - MIND_RNG_BUFFER_SIZE], out);
+        }
+    }
+    _mm256_storeu_si256((__m256i *)rng->s0, s0);
+    _mm256_storeu_si256((__m256i *)rng->s1, s1);
+#else
+    for (uint32_t i = 0; i < 2 * MIND_RNG_BUFFER_SIZE; i += 8) {
+        uint32_t out[8];
+        for (uint8_t lane = 0; lane < 4; lane++) {
+            uint64_t x = rng->s0[lane];
+            uint64_t y = rng->s1[lane];
+            rng->s0[lane] = y;
+            x ^= x << 23;
+            rng->s1[lane] = x ^ y ^ (x >> 17) ^ (y >> 26);
+            uint64_t r = rng->s1[lane] + y;
+            out[2 * lane] = (uint32_t)r;
+            out[2 * lane + 1] = (uint32_t)(r >> 32);
+        }
+
+        for (uint8_t j = 0; j < 8; j++) {
+            if (i < MIND_RNG_BUFFER_SIZE) {
+                rng->floats[i + j] = (float)(out[j] >> 8) * to_unit;
+            } else {
+                rng->ints[i - MIND_RNG_BUFFER_SIZE + j] = out[j];
+            }
+        }
+    }
+#endif
+    rng->i = 0;
+    return;
+}
+
+/// @brief Claims the next slot of the rng's buffers, refilling them if they ran out.
+///        Not thread safe: an rng belongs to one player and is only drawn from by whichever thread owns it at the time
+/// @param rng pointer to an rng struct
+/// @return an index into rng->floats / rng->ints
+uint32_t rngNextSlot(rng_t *rng) {
+    if (rng->i >= MIND_RNG_BUFFER_SIZE) {
+        rngRefill(rng);
+    }
+    return rng->i++;
+}
+
+/// @brief Generates an integer in [0, range) by multiply-shift instead of modulo
+/// @param rng pointer to an rng struct
+/// @param range the number of possible results
+/// @return an integer r such that 0 <= r < range
+uint32_t rngBounded(rng_t *rng, uint32_t range) {
+    return (uint32_t)(((uint64_t)rng->ints[rngNextSlot(rng)] * range) >> 32);
+}
+
+
 //---------------------------------//
 //------PLAYER IMPLEMENTATION------//
 //---------------------------------//
 
-/// @brief Creates a player struct (no mallocs)
+/// @brief Creates a player struct (malloc called once, for the hand)
 /// @param player pointer to a player struct. The shallow memory of the player struct is managed by the caller
 /// @param game pointer to the game struct
 void playerCreate(player_t *player, game_t *game) {
 
     *player = (player_t) {
         .game = game,
-        .skill = randf(MIND_MIN_SKILL, MIND_MAX_SKILL),
-        .n = (uint8_t)(player - game->players) + 1,
-        .beat = randi(MIND_AVERAGE_BEAT, 0.15f)
+        .n = (uint16_t)(player - game->players) + 1
     };
 
     stackCreate(&player->hand, MIND_MAX_LEVEL);
@@ -181,13 +253,33 @@ void playerCreate(player_t *player, game_t *game) {
     return;
 }
 
+/// @brief Gives the player a fresh random stream, skill and beat for a new game (no mallocs)
+/// @param player pointer to a player struct
+void playerReset(player_t *player) {
+    game_t *game = player->game;
+
+    rngCreate(&player->rng, game->seed + (player - game->players) + 1);
+    player->skill = randf(&player->rng, MIND_MIN_SKILL, MIND_MAX_SKILL);
+    player->beat = randi(&player->rng, MIND_AVERAGE_BEAT, 0.15f);
+    player->hand.top = player->hand.cards;
+    memset(player->timeout, 0, sizeof(player->timeout));
+
+    return;
+}
+
 /// @brief Dictates the shuffling routine of a player
 /// @param player pointer to a player struct
-void playerDeckShuffle(player_t *player) {
-    for (uint8_t i = 0; i < 7; i++) {
+/// @param n_passes the number of passes (ruffle + multi cut + shmush). The game always uses MIND_SHUFFLE_PASSES
+void playerDeckShuffle(player_t *player, uint8_t n_passes) {
+    if (player->game->shuffle_mode == SHUFFLE_SURROGATE) {
+        deckSurrogateShuffle(&player->game->deck, player, n_passes);
+        return;
+    }
+
+    for (uint8_t i = 0; i < n_passes; i++) {
         deckRuffle(&player->game->deck, player);
         deckMultiCut(&player->game->deck, player);
-        deckShmush(&player->game->deck);
+        deckShmush(&player->game->deck, player);
     }
     
     return;
@@ -199,28 +291,26 @@ void playerDeckShuffle(player_t *player) {
 thread_return_t playGame(thread_arg_t arg) {
     player_t *player = arg;
     game_t *game = player->game;
-    static atomic_uint_least32_t n_players_ready = 0;
-    static atomic_flag should_wait_for_setup = ATOMIC_FLAG_INIT;
     
     BARRIER_WAIT(game->barrier); // all threads
     while (game->level.n) {
         // Play
         while (!game->level.is_over && stackGetSize(&player->hand)) {
             playTurn(player);
-            SLEEP(player->beat * (game->level.n / 4 + 1));
+            SLEEP((uint32_t)(player->beat * (game->level.n / 4 + 1) * game->time_scale));
             player->count++;
         }
         
         // Only one thread will do the setup for the next level
-        if (atomic_flag_test_and_set(&should_wait_for_setup)) {
-            n_players_ready++;
+        if (atomic_flag_test_and_set(&game->should_wait_for_setup)) {
+            game->n_players_ready++;
             BARRIER_WAIT(game->barrier); // rest of threads
         } else {
             // Do the setup
             BARRIER_WAIT(game->barrier); // 1 thread
             gameLevelNext(game);
-            n_players_ready = 0;
-            atomic_flag_clear(&should_wait_for_setup);
+            game->n_players_ready = 0;
+            atomic_flag_clear(&game->should_wait_for_setup);
         }
         
         BARRIER_WAIT(game->barrier); // all threads
@@ -229,15 +319,32 @@ thread_return_t playGame(thread_arg_t arg) {
     return 0;
 }
 
+/// @brief The thread function of a pooled player (see gamePoolStart): plays every game gamePlay starts, until gamePoolStop
+/// @param arg pointer to a player struct
+/// @return 0 once the pool is stopped
+thread_return_t playPool(thread_arg_t arg) {
+    player_t *player = arg;
+    game_t *game = player->game;
+
+    while (true) {
+        BARRIER_WAIT(game->pool_barrier); // gamePlay set a game up (or gamePoolStop wants us gone)
+        if (game->pool_quit) break;
+        playGame(arg);
+        BARRIER_WAIT(game->pool_barrier); // the game is over, gamePlay may return
+    }
+    return 0;
+}
+
 /// @brief Handles most of the internal logic
 /// @param player pointer to a player struct
 void playTurn(player_t *player) {
     game_t *game = player->game;  
-    uint32_t pile_card = (stackGetSize(&game->pile))? stackPeek(&game->pile): 0;
+    uint32_t pile_size = stackGetSize(&game->pile);
+    uint32_t pile_card = (pile_size)? stackPeek(&game->pile): 0;
     uint32_t lowest_card = stackPeek(&player->hand);
 
-    // check that we haven't lost
-    if (lowest_card < pile_card) {
+    // check that we haven't lost - anyone's lowest card, not just ours, since the pile is read first this can't misfire
+    if (atomic_load(&game->lowest_card) < pile_card) {
         MUTEX_CHECKLOCK(game->pile_mtx, game->level.is_over);
         if (game->level.is_over) return;
 
@@ -252,6 +359,14 @@ void playTurn(player_t *player) {
     if (player->pile_card != pile_card) {
         MUTEX_CHECKLOCK(game->pile_mtx, game->level.is_over);
         if (game->level.is_over) return;
+        // every card played since this player last looked counts, not just the top one (their own aside)
+        uint64_t now = timeNowNs();
+        for (uint32_t i = player->pile_seen; i < pile_size; i++) {
+            if (game->pile_owner[i] != player - game->players) {
+                latencyAdd(&game->level_latency, now - game->play_ns[i]);
+            }
+        }
+        player->pile_seen = pile_size;
         playerAdjust(player, pile_card);
         MUTEX_UNLOCK(game->pile_mtx);
         player->count = (player->count < pile_card)? pile_card: player->count;
@@ -265,7 +380,7 @@ void playTurn(player_t *player) {
     } else if (lowest_card < pile_card + player->threshold) {
         // player gets hasitant if close (higher focus, slower beat)
         playerHesitate(player);
-    } else if ((randf(0.0F, 1.0F) * (1.0F - player->skill)) > 0.8F) {
+    } else if ((randf(&player->rng, 0.0F, 1.0F) * (1.0F - player->skill)) > 0.8F) {
         // player gets randomly confused - loses count
         playerConfused(player); // Don't make him an account
     }
@@ -289,7 +404,7 @@ void playTurn(player_t *player) {
 /// @brief Adjust the player's beat such that their count since the previous card played would have been closer to req_card. Adjustment may be in either direction
 /// @param player pointer to a player struct
 /// @param req_card the card that the player should adjust for
-void playerAdjust(player_t *player, uint8_t req_card) {
+void playerAdjust(player_t *player, uint16_t req_card) {
     if (player->timeout[ADJUST]) {
         player->timeout[ADJUST]--;
         return;
@@ -310,7 +425,7 @@ void playerAdjust(player_t *player, uint8_t req_card) {
     float weight = 0.33F + 1.67F * ((old_beat < MIND_AVERAGE_BEAT) == (change > 1.0F));
 
     uint32_t avg_beat = (uint32_t)((weight * new_beat + old_beat) / (weight + 1.0F));
-    player->beat = randi(avg_beat, playerGetError(player) * 0.5F);
+    player->beat = randi(&player->rng, avg_beat, playerGetError(player) * 0.5F);
     playerFixBeat(player);
     
     return;
@@ -327,7 +442,7 @@ void playerBored(player_t *player) {
 
     player->focus *= 0.95F;
     float err = playerGetError(player) * 0.5F;
-    player->beat = randi(player->beat * (1.0F - err), err / (1.0F - err)) * 0.95F;
+    player->beat = randi(&player->rng, player->beat * (1.0F - err), err / (1.0F - err)) * 0.95F;
 
     playerFixBeat(player);
     playerFixFocus(player);
@@ -346,7 +461,7 @@ void playerHesitate(player_t *player) {
     player->focus += 0.01;
     player->focus *= 1.1F;
     float err = playerGetError(player);
-    player->beat = randi(player->beat * (1.0F + err), err / (1.0F + err)) * 1.1F;
+    player->beat = randi(&player->rng, player->beat * (1.0F + err), err / (1.0F + err)) * 1.1F;
 
     playerFixBeat(player);
     playerFixFocus(player);
@@ -363,7 +478,7 @@ void playerConfused(player_t *player) {
     player->timeout[CONFUSED] = 3;
 
     player->focus *= 0.9F;
-    player->count = randi(player->count, playerGetError(player) * 0.5F);
+    player->count = randi(&player->rng, player->count, playerGetError(player) * 0.5F);
     playerFixFocus(player);
     
     return;
@@ -402,16 +517,27 @@ void playerFixBeat(player_t *player) {
 void playerTryPlay(player_t *player) {
     uint32_t lowest_card = stackPeek(&player->hand);
     game_t *game = player->game;
+    uint32_t pile_size = stackGetSize(&game->pile);
+
+    // the pile only ever goes up: a card below it means the level is lost, and playTurn will notice
+    if (pile_size && lowest_card < stackPeek(&game->pile)) {
+        return;
+    }
 
     if (stackGetSize(&player->hand) < game->level.n_cards &&           // always play the round's final card(s) instantly
         (player->count < lowest_card ||                                // play if count reaches player's lowest card -
-         (lowest_card + game->level.n_cards - 1) > MIND_DECK_SIZE)) {  // - unless card is so high that there are definitely lower cards
+         (lowest_card + game->level.n_cards - 1) > game->deck_size)) { // - unless card is so high that there are definitely lower cards
         return;
     }
 
+    game->play_ns[pile_size] = timeNowNs();
+    game->pile_owner[pile_size] = player - game->players;
     stackMove(&game->pile, &player->hand);
+    gameLowestUpdate(game, player - game->players);
     player->last_card_played = lowest_card;
-    printf("P%02d plays %d\n", player->n + 1, lowest_card);
+    if (game->verbose) {
+        printf("P%02d plays %d\n", player->n + 1, lowest_card);
+    }
     player->count = lowest_card;
     player->pile_card = lowest_card;
     game->level.n_cards--;
@@ -431,38 +557,137 @@ float playerGetError(player_t *player) {
 //-------GAME IMPLEMENTATION-------//
 //---------------------------------//
 
-/// @brief Creates the game struct
+/// @brief The number of cards n_players play with: the standard MIND_DECK_SIZE, or enough to deal everyone the last level
+/// @param n_players the number of players in the game, 1 to MIND_MAX_PLAYERS
+/// @return the deck's size. Its cards are 1 to the deck's size
+uint16_t gameDeckSize(uint16_t n_players) {
+    uint32_t needed = (uint32_t)n_players * MIND_MAX_LEVEL;
+    return (needed > MIND_DECK_SIZE)? needed: MIND_DECK_SIZE;
+}
+
+/// @brief Creates the game struct. All of the game's memory is allocated here; call gameReset to start a game
 /// @param game pointer to the game struct. The shallow memory of the game struct is managed by the caller
-/// @param n_players the number of players in the game (constant)
-void gameCreate(game_t *game, uint8_t n_players) {
+/// @param n_players the number of players in the game (constant), 1 to MIND_MAX_PLAYERS
+void gameCreate(game_t *game, uint16_t n_players) {
+    if (n_players == 0 || n_players > MIND_MAX_PLAYERS) {
+        _threads_api_Panik("n_players must be 1 to MIND_MAX_PLAYERS: the deck's cards wouldn't fit a uint16_t!");
+    }
+
     *game = (game_t) {
         .n_players = n_players,
+        .deck_size = gameDeckSize(n_players),
+        .shuffle_mode = MIND_SHUFFLE_MODE,
+        .time_scale = 1.0F,
+        .skip_above = 1.0F,
+        .should_wait_for_setup = ATOMIC_FLAG_INIT,
         .players = malloc(sizeof(player_t) * n_players)
     };
+    game->n_leaves = 1;
+    while (game->n_leaves < n_players) {
+        game->n_leaves <<= 1;
+    }
+    game->lowest_tree = malloc(sizeof(*game->lowest_tree) * 2 * game->n_leaves);
+    game->play_ns = malloc(sizeof(*game->play_ns) * game->deck_size);
+    game->pile_owner = malloc(sizeof(*game->pile_owner) * game->deck_size);
+    game->scratch = malloc(sizeof(*game->scratch) * game->deck_size);
+    game->evaluate_next = malloc(sizeof(*game->evaluate_next) * n_players);
+    if (game->players == NULL || game->lowest_tree == NULL || game->play_ns == NULL || game->pile_owner == NULL ||
+        game->scratch == NULL || game->evaluate_next == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
 
     for (player_t *player = game->players; player < game->players + game->n_players; player++) {
         playerCreate(player, game);
     }
 
-    stackCreate(&game->deck, MIND_DECK_SIZE);
-    for (uint8_t i = MIND_DECK_SIZE; i > 0; i--) {
-        stackPush(&game->deck, i);
-    }
-
-    stackCreate(&game->pile, MIND_DECK_SIZE);
+    stackCreate(&game->deck, game->deck_size);
+    stackCreate(&game->pile, game->deck_size);
     
     MUTEX_INIT(game->pile_mtx);
     MUTEX_INIT(game->print_mtx);
     BARRIER_INIT(game->barrier, n_players);
 
+    return;
+}
+
+/// @brief Starts a new game on an existing game struct: new players (skills, beats), ordered deck, level 1. No mallocs
+/// @param game pointer to the game struct
+/// @param seed the new game's random seed. The same seed always deals the same players and shuffles
+void gameReset(game_t *game, uint64_t seed) {
+    game->seed = seed;
+    game->won = false;
+    game->n_levels_played = 0;
+    game->n_levels_won = 0;
+    game->best_level = 0;
+
+    for (player_t *player = game->players; player < game->players + game->n_players; player++) {
+        playerReset(player);
+    }
+
+    game->pile.top = game->pile.cards;
+    game->deck.top = game->deck.cards;
+    for (uint16_t i = game->deck_size; i > 0; i--) {
+        stackPush(&game->deck, i);
+    }
+
     gameLevelSetup(game, 1);
 
     return;
 }
 
-/// @brief Destroys game struct, freeing all the internal memory allocated for its children
+/// @brief Plays the game that gameReset set up, one thread per player, until it is won (or abandoned, see max_levels).
+///        The threads are the pool's if there is one, otherwise they are created for this game alone
+/// @param game pointer to the game struct
+void gamePlay(game_t *game) {
+    if (game->has_pool) {
+        BARRIER_WAIT(game->pool_barrier);
+        BARRIER_WAIT(game->pool_barrier);
+        return;
+    }
+
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        THREAD_CREATE(game->players[i].thread, playGame, &game->players[i]);
+    }
+
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        THREAD_JOIN(game->players[i].thread);
+    }
+    return;
+}
+
+/// @brief Starts one thread per player that plays every game gamePlay is called for, so games on this struct no longer
+///        create (and allocate for) threads of their own
+/// @param game pointer to the game struct
+void gamePoolStart(game_t *game) {
+    BARRIER_INIT(game->pool_barrier, game->n_players + 1); // the players and gamePlay's caller
+    game->pool_quit = false;
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        THREAD_CREATE(game->players[i].thread, playPool, &game->players[i]);
+    }
+    game->has_pool = true;
+    return;
+}
+
+/// @brief Stops the pool's threads. Call between games
+/// @param game pointer to the game struct
+void gamePoolStop(game_t *game) {
+    game->pool_quit = true;
+    BARRIER_WAIT(game->pool_barrier);
+    for (uint16_t i = 0; i < game->n_players; i++) {
+        THREAD_JOIN(game->players[i].thread);
+    }
+    BARRIER_DESTROY(game->pool_barrier);
+    game->has_pool = false;
+    return;
+}
+
+/// @brief Destroys game struct, freeing all the internal memory allocated for its children (and stopping its pool)
 /// @param game pointer to the game struct 
 void gameDestroy(game_t *game) {
+    if (game->has_pool) {
+        gamePoolStop(game);
+    }
     stackDestroy(&game->deck);
     stackDestroy(&game->pile);
     
@@ -471,6 +696,11 @@ void gameDestroy(game_t *game) {
     }
 
     free(game->players);
+    free(game->lowest_tree);
+    free(game->play_ns);
+    free(game->pile_owner);
+    free(game->scratch);
+    free(game->evaluate_next);
     MUTEX_DESTROY(game->pile_mtx);
     MUTEX_DESTROY(game->print_mtx);
     BARRIER_DESTROY(game->barrier);
@@ -483,52 +713,101 @@ void gameDestroy(game_t *game) {
 void gameLevelSetup(game_t *game, uint8_t n_level) {
 
     // Each round, a different player shuffles the deck
-    playerDeckShuffle(&game->players[n_level % game->n_players]);
+    playerDeckShuffle(&game->players[n_level % game->n_players], MIND_SHUFFLE_PASSES);
     
     // Print level and deck
-    printf("~~~~~~~~~~~~~~~~~~\n"    \
-           "~~~~~LEVEL %02d~~~~~\n" \
-           "~~~~~~~~~~~~~~~~~~\n\n"  ,
-           n_level);
+    if (game->verbose) {
+        printf("~~~~~~~~~~~~~~~~~~\n"    \
+               "~~~~~LEVEL %02d~~~~~\n" \
+               "~~~~~~~~~~~~~~~~~~\n\n"  ,
+               n_level);
+    }
     gameLog(game, DECK);
 
     size_t deck_size = stackGetSize(&game->deck);
     // Handing cards to players, sorted descending; set player counts etc.
-    uint8_t *temp_buffer = malloc(sizeof(*temp_buffer) * n_level);
+    uint16_t temp_buffer[MIND_MAX_LEVEL];
     for (player_t *player = game->players; player < game->players + game->n_players; player++) {
         stackPopN(&game->deck, temp_buffer, n_level);
         qsort(temp_buffer, n_level, sizeof(temp_buffer[0]), reverseCompare);
         stackPushN(&player->hand, temp_buffer, n_level);
-        player->threshold = randi(deck_size / (n_level * game->n_players), playerGetError(player));
+        player->threshold = randi(&player->rng, deck_size / (n_level * game->n_players), playerGetError(player));
         player->focus = 0.5F;
         player->count = 0;
         // memset(player->timeout, 0, mind_n_player_effects * sizeof(player->timeout[0]));
         player->pile_card = 0;
+        player->pile_seen = 0;
         player->last_card_played = 0;
         player->n = player - game->players;
 
         gameLog(game, HAND, player->n);
     }
-    free(temp_buffer);
+    gameLowestBuild(game);
 
     game->level.n = n_level;
     game->level.n_cards = game->level.n * game->n_players;
     game->level.is_over = false;
     game->level.status = false;
+    game->level.blame_fast = MIND_NO_PLAYER;
+    game->level.blame_slow = MIND_NO_PLAYER;
+    game->level_latency = (mind_latency_t) {0};
+
+    // Near certain deals don't need to be played out; the dealer flips a coin with the evaluator's odds instead.
+    // A skip_sample share of them is played out all the same, each standing in for 1 / skip_sample of its kind, so
+    // the win rate over every deal can be estimated from the simulated levels alone (importance sampling)
+    rng_t *dealer_rng = &game->players[n_level % game->n_players].rng;
+    game->level.p_win = evaluateLevel(game);
+    game->level.simulated = true;
+    game->level.weight = 1.0F;
+    if (game->level.p_win > game->skip_above) {
+        game->level.simulated = game->skip_sample > 0.0F && randf(dealer_rng, 0.0F, 1.0F) < game->skip_sample;
+        game->level.weight = (game->level.simulated)? 1.0F / game->skip_sample: 0.0F;
+    }
+    if (!game->level.simulated) {
+        game->level.status = randf(dealer_rng, 0.0F, 1.0F) < game->level.p_win;
+        game->level.n_cards = (game->level.status)? 0: game->level.n_cards;
+        game->level.is_over = true;
+    }
     
     return;
 }
 
-/// @brief Report last level's status, return player hands to the deck, check win condition, setup next level
+/// @brief Report last level's status, return player hands to the deck, check win condition, setup next level (and checkpoint it)
 /// @param game pointer to the game struct 
 void gameLevelNext(game_t *game) {
     
-    if (game->level.status) {
-        printf("\nLEVEL %02d WON!\n", game->level.n);
-    } else {
-        printf("\nLEVEL %02d LOST! resetting...\n", game->level.n);
+    if (game->verbose) {
+        printf("\nLEVEL %02d %s\n", game->level.n, game->level.status? "WON!": "LOST! resetting...");
     }
     SLEEP(0);
+    if (game->heartbeat_ns != NULL) {
+        atomic_store(game->heartbeat_ns, timeNowNs());
+    }
+    // The blamed players adjust only now, while every other thread waits on the barrier: whoever noticed the loss
+    // must not draw from their rngs while they are still running (see gameAssignBlame)
+    if (game->level.blame_fast != MIND_NO_PLAYER) {
+        playerAdjust(&game->players[game->level.blame_slow], game->level.blame_card_slow);
+        playerAdjust(&game->players[game->level.blame_fast], game->level.blame_card_fast);
+    }
+    game->n_levels_played++;
+    game->stats[game->level.n].n_played++;
+    game->stats[game->level.n].n_lost += !game->level.status;
+    latencyMerge(&game->stats[game->level.n].latency, &game->level_latency);
+    if (game->level.simulated) {
+        game->stats[game->level.n].n_simulated++;
+        game->stats[game->level.n].n_simulated_won += game->level.status;
+        game->stats[game->level.n].sum_p_win += game->level.p_win;
+        game->stats[game->level.n].sum_weight += game->level.weight;
+        game->stats[game->level.n].sum_weight_won += game->level.weight * game->level.status;
+    }
+    if (game->level.status) {
+        game->n_levels_won++;
+        game->best_level = (game->level.n > game->best_level)? game->level.n: game->best_level;
+    }
+
+    if (game->results != NULL) {
+        resultsAppendLevel(game->results, game);
+    }
 
     for (player_t *player = game->players; player < game->players + game->n_players; player++) {
         stackMoveN(&game->deck, &player->hand, stackGetSize(&player->hand));
@@ -536,43 +815,89 @@ void gameLevelNext(game_t *game) {
     stackMoveN(&game->deck, &game->pile, stackGetSize(&game->pile));
 
     if (game->level.n == MIND_MAX_LEVEL && game->level.status) {
+        game->won = true;
         game->level.n = 0; // signal for win
         return;
     }
+    if (game->max_levels && game->n_levels_played >= game->max_levels) {
+        game->level.n = 0; // out of attempts; the game is abandoned
+        return;
+    }
     // If we lost, reset to level 1, otherwise advance to the next level
     gameLevelSetup(game, (game->level.n * game->level.status) + 1);
+    if (game->checkpoint != NULL) {
+        checkpointSaveGame(game->checkpoint, game);
+    }
     return;
 }
 
-/// @brief Ooooo, Ahhhh! Adjust the two players that are the most responsible for the loss. TODO: make the adjustment more dynamic and on more players
+/// @brief Ooooo, Ahhhh! Find the two players that are the most responsible for the loss. TODO: make the adjustment more dynamic and on more players.
+///        They adjust in gameLevelNext: their threads are still running here, and their rngs are theirs alone
 /// @param game pointer to the game struct 
 void gameAssignBlame(game_t *game) {
-    uint8_t pile_card = stackPeek(&game->pile);
-    // find the lowest card in hands that is lower than the pile's card
-    uint8_t lowest = MIND_DECK_SIZE;
-    uint8_t i_slow_player = 0;
-    for (size_t i = 0; i < game->n_players; i++) {
-        player_t *player = &game->players[i];
-        if (stackGetSize(&player->hand) == 0) continue;
-        uint8_t card = stackPeek(&player->hand);
-        if (card < lowest) {
-            i_slow_player = i;
-            lowest = card;
+    // the lowest card in any hand (it's lower than the pile's card) is the tree's root
+    uint32_t root = game->lowest_tree[1];
+    uint16_t lowest = root >> 16;
+    uint16_t i_slow_player = root & 0xFFFF;
+
+    // find the first card played that is higher than the lowest. The pile is sorted, so binary search it
+    uint32_t lo = 0;
+    uint32_t hi = stackGetSize(&game->pile) - 1; // the top card is higher, that's how we got here
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (game->pile.cards[mid] > lowest) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
         }
     }
+    uint16_t first = game->pile.cards[lo];
+    uint16_t i_fast_player = game->pile_owner[lo];
 
-    uint8_t first = pile_card;
-    uint8_t i_fast_player = 0;
-    // find the player who played the first card that is higher than the lowest
-    for (size_t i = 0; i < game->n_players; i++) {
-        uint8_t card = game->players[i].last_card_played;
-        if (card > lowest && card < first) {
-            i_fast_player = i;
-            first = card;
-        }
+    game->level.blame_slow = i_slow_player;
+    game->level.blame_fast = i_fast_player;
+    game->level.blame_card_slow = first;
+    game->level.blame_card_fast = lowest;
+    return;
+}
+
+/// @brief Rebuilds the lowest card tree from scratch, after dealing
+/// @param game pointer to the game struct
+void gameLowestBuild(game_t *game) {
+    uint32_t *tree = game->lowest_tree;
+
+    for (uint32_t i = 0; i < game->n_leaves; i++) {
+        stack_t *hand = &game->players[i].hand;
+        uint32_t card = (i < game->n_players && stackGetSize(hand))? stackPeek(hand): MIND_NO_CARD;
+        tree[game->n_leaves + i] = (card << 16) | i;
+    }
+    for (uint32_t node = game->n_leaves - 1; node > 0; node--) {
+        uint32_t left = tree[2 * node];
+        uint32_t right = tree[2 * node + 1];
+        tree[node] = (left < right)? left: right;
+    }
+
+    atomic_store(&game->lowest_card, tree[1] >> 16);
+    return;
+}
+
+/// @brief Updates the lowest card tree after a player's hand changed: O(log n_players). Call with pile_mtx held
+/// @param game pointer to the game struct
+/// @param i_player the player whose lowest card changed
+void gameLowestUpdate(game_t *game, uint16_t i_player) {
+    uint32_t *tree = game->lowest_tree;
+    stack_t *hand = &game->players[i_player].hand;
+    uint32_t card = (stackGetSize(hand))? stackPeek(hand): MIND_NO_CARD;
+    uint32_t node = game->n_leaves + i_player;
+
+    tree[node] = (card << 16) | i_player;
+    for (node /= 2; node > 0; node /= 2) {
+        uint32_t left = tree[2 * node];
+        uint32_t right = tree[2 * node + 1];
+        tree[node] = (left < right)? left: right;
     }
-    playerAdjust(&game->players[i_slow_player], first);
-    playerAdjust(&game->players[i_fast_player], lowest);
+
+    atomic_store(&game->lowest_card, tree[1] >> 16);
     return;
 }
 
@@ -582,6 +907,8 @@ void gameAssignBlame(game_t *game) {
 /// @param type DECK, PILE or HAND
 /// @param n_player (uint32_t) (optional): in case HAND was chosen, n_player specifies which player's hand is to be printed.
 void gameLog(game_t *game, mind_stack_type_t type, ...) {
+    if (!game->verbose) return;
+
     va_list args;
     va_start(args, type);
     char stack_name[0x80] = {0};
@@ -610,6 +937,112 @@ void gameLog(game_t *game, mind_stack_type_t type, ...) {
     return;
 }
 
+
+//---------------------------------//
+//-----LATENCY IMPLEMENTATION------//
+//---------------------------------//
+
+/// @brief Records one reaction latency
+/// @param latency pointer to a latency struct
+/// @param ns the time from the card being played to it being noticed
+void latencyAdd(mind_latency_t *latency, uint64_t ns) {
+    uint32_t bucket = (ns)? 63 - __builtin_clzll(ns): 0;
+    latency->hist[bucket]++;
+    latency->n++;
+    latency->sum_ns += ns;
+    latency->max_ns = (ns > latency->max_ns)? ns: latency->max_ns;
+    return;
+}
+
+/// @brief Adds one distribution into another
+/// @param dst the accumulated distribution
+/// @param src the distribution to add
+void latencyMerge(mind_latency_t *dst, const mind_latency_t *src) {
+    for (uint32_t i = 0; i < MIND_LATENCY_BUCKETS; i++) {
+        dst->hist[i] += src->hist[i];
+    }
+    dst->n += src->n;
+    dst->sum_ns += src->sum_ns;
+    dst->max_ns = (src->max_ns > dst->max_ns)? src->max_ns: dst->max_ns;
+    return;
+}
+
+/// @brief Estimates a percentile of the distribution (to within its power of 2 bucket)
+/// @param latency pointer to a latency struct
+/// @param q between 0 and 1
+/// @return the upper edge of the bucket the percentile falls in, in ns (never more than the max seen)
+uint64_t latencyPercentile(const mind_latency_t *latency, double q) {
+    uint64_t target = (uint64_t)ceil(q * latency->n);
+    uint64_t acc = 0;
+    for (uint32_t i = 0; i < MIND_LATENCY_BUCKETS; i++) {
+        acc += latency->hist[i];
+        if (acc >= target && acc) {
+            uint64_t edge = (i < 63)? (2ULL << i): UINT64_MAX;
+            return (edge < latency->max_ns)? edge: latency->max_ns;
+        }
+    }
+    return 0;
+}
+
+/// @brief Adds one set of per level number stats into another, e.g. those of games played on another game struct
+/// @param dst the accumulated stats, MIND_MAX_LEVEL + 1 of them
+/// @param src the stats to add, MIND_MAX_LEVEL + 1 of them
+void statsMerge(mind_stats_t *dst, const mind_stats_t *src) {
+    for (uint8_t n = 0; n <= MIND_MAX_LEVEL; n++) {
+        latencyMerge(&dst[n].latency, &src[n].latency);
+        dst[n].n_played += src[n].n_played;
+        dst[n].n_lost += src[n].n_lost;
+        dst[n].n_simulated += src[n].n_simulated;
+        dst[n].n_simulated_won += src[n].n_simulated_won;
+        dst[n].sum_p_win += src[n].sum_p_win;
+        dst[n].sum_weight += src[n].sum_weight;
+        dst[n].sum_weight_won += src[n].sum_weight_won;
+    }
+    return;
+}
+
+/// @brief Prints, for every level number played out so far (not skipped), its loss rate next to the distribution of reaction latencies.
+///        Losses that go with long tails point at OS scheduling rather than at the players
+/// @param stats per level number stats, e.g. game_t.stats
+/// @param out where to print (e.g. stdout)
+void statsLatencyReport(const mind_stats_t *stats, FILE *out) {
+    fprintf(out, "level  played  loss rate  reactions    mean us     p50 us     p99 us     max us\n");
+    for (uint8_t n = 1; n <= MIND_MAX_LEVEL; n++) {
+        // levels the evaluator decided by a coin flip have no latencies, so they don't count toward the loss rate either
+        const mind_latency_t *latency = &stats[n].latency;
+        uint32_t n_simulated = stats[n].n_simulated;
+        if (n_simulated == 0) continue;
+
+        fprintf(out, "%5u  %6u  %9.3f  %9llu  %9.1f  %9.1f  %9.1f  %9.1f\n",
+                n, n_simulated, (double)(n_simulated - stats[n].n_simulated_won) / n_simulated,
+                (unsigned long long)latency->n, latency->n? latency->sum_ns / 1e3 / latency->n: 0.0,
+                latencyPercentile(latency, 0.5) / 1e3, latencyPercentile(latency, 0.99) / 1e3, latency->max_ns / 1e3);
+    }
+    return;
+}
+
+/// @brief Checks the simulation against evaluateLevel's baseline: for every level number, the observed win rate of the
+///        levels that were played out next to the mean predicted win probability of the same deals. Once levels are
+///        skipped, the played out ones lean towards hard deals: 'weighted' reweights them (see skip_sample) into an
+///        estimate over every deal, which only covers the skipped kind if skip_sample > 0
+/// @param stats per level number stats, e.g. game_t.stats
+/// @param out where to print (e.g. stdout)
+void statsEvaluationReport(const mind_stats_t *stats, FILE *out) {
+    fprintf(out, "level  played  skipped  win rate  predicted  weighted\n");
+    for (uint8_t n = 1; n <= MIND_MAX_LEVEL; n++) {
+        uint32_t n_simulated = stats[n].n_simulated;
+        if (stats[n].n_played == 0) continue;
+
+        fprintf(out, "%5u  %6u  %7u  %8.3f  %9.3f  %8.3f\n",
+                n, n_simulated, stats[n].n_played - n_simulated,
+                n_simulated? (double)stats[n].n_simulated_won / n_simulated: 0.0,
+                n_simulated? stats[n].sum_p_win / n_simulated: 0.0,
+                (stats[n].sum_weight > 0)? stats[n].sum_weight_won / stats[n].sum_weight: 0.0);
+    }
+    return;
+}
+
+
 //---------------------------//
 //-----------UTILS-----------//
 //---------------------------//
@@ -619,113 +1052,255 @@ void gameLog(game_t *game, mind_stack_type_t type, ...) {
 /// @param arg2 card 
 /// @return a negative number if arg1 > arg2, a positive if arg2 > arg1, 0 if arg1 == arg2
 int reverseCompare (const void *arg1, const void *arg2) {
-    int a = *(const uint8_t *)arg1;
-    int b = *(const uint8_t *)arg2;
+    int a = *(const uint16_t *)arg1;
+    int b = *(const uint16_t *)arg2;
     return b - a;
 }
 
 /// @brief Shuffles by interleaving two halfs of the deck. Accuracy depends on player's skill
-/// @param deck The deck of cards containing numbers 1 to 100
+/// @param deck The deck of cards containing numbers 1 to its game's deck_size
 /// @param player pointer to a player struct
 void deckRuffle(stack_t *deck, player_t *player) {
     uint32_t sz = stackGetSize(deck);
-    uint32_t half_deck = randi(sz / 2, playerGetError(player));
-    uint8_t temp_deck[MIND_DECK_SIZE];
+    uint32_t half_deck = randi(&player->rng, sz / 2, playerGetError(player));
+    uint16_t *temp_deck = player->game->scratch;
      
-    uint8_t *halfs[] = {deck->cards, deck->cards + half_deck};
+    uint16_t *halfs[] = {deck->cards, deck->cards + half_deck};
     uint8_t i_halfs = 0;
 
-    for (uint8_t i = 0; i < sz; i++) {
+    for (uint32_t i = 0; i < sz; i++) {
         // stop shuffling if one of the halfs is finished
         if (halfs[0] >= deck->cards + half_deck) {
-            memcpy_s(&temp_deck[i], sz - i, halfs[1], deck->top - halfs[1]);
+            memcpy_s(&temp_deck[i], (sz - i) * sizeof(*temp_deck), halfs[1], (deck->top - halfs[1]) * sizeof(*temp_deck));
             break;
         } else if (halfs[1] >= deck->top) {
-            memcpy_s(&temp_deck[i], sz - i, halfs[0], deck->cards + half_deck - halfs[0]);
+            memcpy_s(&temp_deck[i], (sz - i) * sizeof(*temp_deck), halfs[0], (deck->cards + half_deck - halfs[0]) * sizeof(*temp_deck));
             break;
         }
 
         // the actual shuffle
-        i_halfs += (randf(0, 1) < player->skill);
+        i_halfs += (randf(&player->rng, 0, 1) < player->skill);
         i_halfs &= 1;
         temp_deck[i] = *halfs[i_halfs]++;
     }
 
-    memcpy_s(deck->cards, MIND_DECK_SIZE, temp_deck, sz);
+    memcpy_s(deck->cards, deck->allocd * sizeof(*temp_deck), temp_deck, sz * sizeof(*temp_deck));
     return;
 }
 
 /// @brief Move a small packet of cards from the top to the bottom of the deck, multiple times in a row
-/// @param deck The deck of cards containing numbers 1 to 100
+/// @param deck The deck of cards containing numbers 1 to its game's deck_size
 /// @param player pointer to a player struct
 void deckMultiCut(stack_t *deck, player_t *player) {
     static const uint32_t MIN_REPS = 2;
     static const uint32_t MAX_REPS = 6;
 
     uint32_t sz = stackGetSize(deck);
-    uint8_t temp_deck[MIND_DECK_SIZE];
-    uint8_t n_reps = rand() % (MAX_REPS - MIN_REPS) + MIN_REPS;
-    uint32_t half_deck = randi(sz / n_reps, playerGetError(player));
+    uint16_t *temp_deck = player->game->scratch;
+    uint8_t n_reps = rngBounded(&player->rng, MAX_REPS - MIN_REPS) + MIN_REPS;
+    uint32_t half_deck = randi(&player->rng, sz / n_reps, playerGetError(player));
     uint32_t acc;
 
     for (acc = half_deck; acc < sz; acc += half_deck) {
-         memcpy_s(temp_deck + sz - acc, sz, deck->cards + acc - half_deck, half_deck);
-         half_deck = randi(sz / n_reps, playerGetError(player));
+         memcpy_s(temp_deck + sz - acc, acc * sizeof(*temp_deck), deck->cards + acc - half_deck, half_deck * sizeof(*temp_deck));
+         half_deck = randi(&player->rng, sz / n_reps, playerGetError(player));
     }
     acc -= half_deck;
-    memcpy_s(temp_deck, sz, deck->cards + acc, sz - acc);
+    memcpy_s(temp_deck, sz * sizeof(*temp_deck), deck->cards + acc, (sz - acc) * sizeof(*temp_deck));
 
-    memcpy_s(deck->cards, sz, temp_deck, sz);
+    memcpy_s(deck->cards, sz * sizeof(*temp_deck), temp_deck, sz * sizeof(*temp_deck));
     return;
 }
 
 /// @brief Randomly smear the cards on the table. Amounts to randomly transfering packets from anywhere to anywhere in the pile.
-/// @param deck The deck of cards containing numbers 1 to 100
-void deckShmush(stack_t *deck) {
+/// @param deck The deck of cards containing numbers 1 to its game's deck_size
+/// @param player pointer to the player doing the shmushing (only their rng is used)
+void deckShmush(stack_t *deck, player_t *player) {
     static const uint32_t MIN_REPS = 8;
     static const uint32_t MAX_REPS = 16;
     
     uint32_t sz = stackGetSize(deck);
-    uint8_t temp_deck[MIND_DECK_SIZE];
-    uint8_t n_reps = rand() % (MAX_REPS - MIN_REPS) + MIN_REPS;
+    uint16_t *temp_deck = player->game->scratch;
+    uint8_t n_reps = rngBounded(&player->rng, MAX_REPS - MIN_REPS) + MIN_REPS;
 
     for (uint32_t i = 0; i < n_reps; i++) {
-        uint32_t n = ((rand() % (sz / 8)) + 8) * sizeof(*temp_deck); // from 8 to 20 cards in each shmush
-        uint8_t *src = deck->cards + rand() % (sz - n);
-        uint8_t *dst = deck->cards + rand() % (sz - (3 * n));
+        uint32_t n = rngBounded(&player->rng, sz / 8) + 8; // from 8 to 20 cards in each shmush (a 100 card deck)
+        uint16_t *src = deck->cards + rngBounded(&player->rng, sz - n);
+        uint16_t *dst = deck->cards + rngBounded(&player->rng, sz - (3 * n));
         uintptr_t diff = (src > dst)? src - dst: dst - src;
         if (diff < n) {
             dst += 2 * n;
         }
         
-        memcpy_s(temp_deck, sz, dst, n);
-        memcpy_s(dst, sz, src, n);
-        memcpy_s(src, sz, temp_deck, n);
+        memcpy_s(temp_deck, sz * sizeof(*temp_deck), dst, n * sizeof(*temp_deck));
+        memcpy_s(dst, n * sizeof(*temp_deck), src, n * sizeof(*temp_deck));
+        memcpy_s(src, n * sizeof(*temp_deck), temp_deck, n * sizeof(*temp_deck));
     }
 
     return;
 }
 
+/// @brief Statistical stand-in for playerDeckShuffle. From MIND_SHUFFLE_PASSES passes on, the physical routine leaves
+///        the deck uniformly shuffled (shuffleValidate checks it does), so a single Fisher-Yates shuffle is all it takes.
+///        Fewer passes leave structure behind (rising sequences, neighbours kept together) that no cheaper model was
+///        found to reproduce, so those are played out physically
+/// @param deck The deck of cards containing numbers 1 to its game's deck_size
+/// @param player pointer to the player doing the shuffling (skill and rng)
+/// @param n_passes the number of physical passes (ruffle + multi cut + shmush) to imitate
+void deckSurrogateShuffle(stack_t *deck, player_t *player, uint8_t n_passes) {
+    uint32_t sz = stackGetSize(deck);
+
+    if (n_passes < MIND_SHUFFLE_PASSES) {
+        for (uint8_t i = 0; i < n_passes; i++) {
+            deckRuffle(deck, player);
+            deckMultiCut(deck, player);
+            deckShmush(deck, player);
+        }
+        return;
+    }
+
+    for (uint32_t i = sz - 1; i > 0; i--) {
+        uint32_t j = rngBounded(&player->rng, i + 1);
+        uint16_t card = deck->cards[i];
+        deck->cards[i] = deck->cards[j];
+        deck->cards[j] = card;
+    }
+    return;
+}
+
+/// @brief Validation harness for the surrogate shuffle (make validate-shuffle builds and runs it).
+///        For a few skills, shuffles an ordered deck n_samples times with MIND_SHUFFLE_PASSES physical passes, again
+///        with an independent physical run (the noise floor) and with the surrogate, then compares rising sequences,
+///        surviving neighbours (within 4 standard errors + 1%) and the per card position distributions (TV within 10%
+///        of the noise floor)
+/// @param n_samples number of shuffles per model and skill
+/// @param seed seed for the players' rngs
+/// @return true if the surrogate is within noise of the physical model everywhere
+bool shuffleValidate(uint32_t n_samples, uint64_t seed) {
+    static const float skills[] = {MIND_MIN_SKILL, (MIND_MIN_SKILL + MIND_MAX_SKILL) / 2, MIND_MAX_SKILL};
+    enum {PHYSICAL, PHYSICAL_AGAIN, SURROGATE, n_models};
+    bool passed = true;
+
+    // position[model][card][position] histograms
+    uint32_t (*position)[MIND_DECK_SIZE + 1][MIND_DECK_SIZE] = calloc(n_models, sizeof(*position));
+    if (position == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+
+    printf("model       skill  rising seqs  neighbours  position TV  ns/shuffle\n");
+    for (size_t i_skill = 0; i_skill < sizeof(skills) / sizeof(skills[0]); i_skill++) {
+        double sum[n_models][2] = {0};
+        double sum_sq[n_models][2] = {0};
+        memset(position, 0, n_models * sizeof(*position));
+
+        for (uint8_t model = 0; model < n_models; model++) {
+            uint16_t scratch[MIND_DECK_SIZE];
+            game_t game = {.n_players = 1, .deck_size = MIND_DECK_SIZE, .scratch = scratch,
+                           .shuffle_mode = (model == SURROGATE)? SHUFFLE_SURROGATE: SHUFFLE_PHYSICAL};
+            player_t player = {.game = &game, .skill = skills[i_skill], .focus = 0.5F};
+            game.players = &player;
+            rngCreate(&player.rng, seed + model);
+            stackCreate(&game.deck, MIND_DECK_SIZE);
+            
+            struct timespec start, end;
+            double ns = 0;
+            for (uint32_t sample = 0; sample < n_samples; sample++) {
+                game.deck.top = game.deck.cards;
+                for (uint8_t card = MIND_DECK_SIZE; card > 0; card--) {
+                    stackPush(&game.deck, card);
+                }
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                playerDeckShuffle(&player, MIND_SHUFFLE_PASSES);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+                // rising sequences (the deck started in descending order) and neighbours that are still together
+                uint8_t where[MIND_DECK_SIZE + 1];
+                double stat[2] = {1, 0};
+                for (uint8_t i = 0; i < MIND_DECK_SIZE; i++) {
+                    where[game.deck.cards[i]] = i;
+                    position[model][game.deck.cards[i]][i]++;
+                }
+                for (uint8_t card = 1; card < MIND_DECK_SIZE; card++) {
+                    stat[0] += (where[card + 1] < where[card]);
+                    stat[1] += (abs(where[card + 1] - where[card]) == 1);
+                }
+                for (uint8_t j = 0; j < 2; j++) {
+                    sum[model][j] += stat[j];
+                    sum_sq[model][j] += stat[j] * stat[j];
+                }
+            }
+            stackDestroy(&game.deck);
+
+            // total variation distance from the physical model's position distribution, averaged over cards
+            double tv = 0;
+            for (uint8_t card = 1; card <= MIND_DECK_SIZE && model != PHYSICAL; card++) {
+                for (uint8_t i = 0; i < MIND_DECK_SIZE; i++) {
+                    tv += fabs((double)position[model][card][i] - position[PHYSICAL][card][i]) / (2.0 * n_samples * MIND_DECK_SIZE);
+                }
+            }
+            printf("%-10s  %.2f  %11.3f  %10.3f  %11.4f  %10.0f\n", (model == SURROGATE)? "surrogate": "physical",
+                   skills[i_skill], sum[model][0] / n_samples, sum[model][1] / n_samples, tv, ns / n_samples);
+
+            if (model == PHYSICAL_AGAIN) {
+                sum[PHYSICAL_AGAIN][0] = tv; // only the noise floor of the TV is needed from here on
+            } else if (model == SURROGATE) {
+                for (uint8_t j = 0; j < 2; j++) {
+                    double mean = sum[PHYSICAL][j] / n_samples;
+                    double var = (sum_sq[PHYSICAL][j] / n_samples - mean * mean) + (sum_sq[SURROGATE][j] / n_samples - pow(sum[SURROGATE][j] / n_samples, 2));
+                    passed &= fabs(sum[SURROGATE][j] / n_samples - mean) < 4.0 * sqrt(var / n_samples) + 0.01 * mean;
+                }
+                passed &= tv < 1.1 * sum[PHYSICAL_AGAIN][0];
+            }
+        }
+    }
+    free(position);
+
+    printf("\nsurrogate shuffle %s\n", passed? "PASSED": "FAILED");
+    return passed;
+}
+
 /// @brief Generates a float between two numbers
+/// @param rng the random stream to draw from
 /// @param a min
 /// @param b max
-/// @return a float f such that a < f < b
-float randf(float a, float b) {
-   return ((b - a) * ((float)rand() / (RAND_MAX + 1))) + a;
+/// @return a float f such that a <= f < b
+float randf(rng_t *rng, float a, float b) {
+   return ((b - a) * rng->floats[rngNextSlot(rng)]) + a;
 }
 
 /// @brief Generates an integer around n
+/// @param rng the random stream to draw from
 /// @param n the average number to be generated
 /// @param err the % around n that may be generated in each direction
 /// @return an integer m such that n * (1 - err) < m < n * (1 + err)
-uint32_t randi(uint32_t n, float err) {
+uint32_t randi(rng_t *rng, uint32_t n, float err) {
     uint32_t e = n * err;
     if (!e) return n;
-    return ((rand() % (2 * e)) + n - e);
+    return (rngBounded(rng, 2 * e) + n - e);
 }
 
+/// @brief One step of the splitmix64 generator. Used to expand a single seed into many independent ones
+/// @param state the generator's state, advanced in place
+/// @return 64 well mixed bits
+uint64_t splitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/// @brief Monotonic clock, for timing events across threads
+/// @return nanoseconds since some fixed point in the past
+uint64_t timeNowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
 
-/// @brief Generates a truly random number for seeding into rand()
+/// @brief Generates a truly random number for seeding the game
 unsigned int trueRand(void) {
     unsigned int res = 0;
     int n_fails = 0;
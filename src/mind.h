@@ -14,14 +14,23 @@
 #include <immintrin.h>
 #include <threads/threads_api.h>
 
-#define MIND_DECK_SIZE (100)
+#define MIND_DECK_SIZE (100) // the smallest deck: bigger groups play with n_players * MIND_MAX_LEVEL cards (see gameDeckSize)
 #define MIND_N_PLAYERS (3)
 #define MIND_MAX_LEVEL (12)
+#define MIND_MAX_PLAYERS (UINT16_MAX / MIND_MAX_LEVEL) // the biggest deck's cards (and MIND_NO_CARD) must fit a uint16_t
 #define MIND_MIN_SKILL 0.66f
 #define MIND_MAX_SKILL 0.90f
 #define MIND_AVERAGE_BEAT (100)
 #define MIND_MAX_BEAT (MIND_AVERAGE_BEAT * 3)
 #define MIND_MIN_BEAT (MIND_AVERAGE_BEAT / 3)
+#define MIND_NO_PLAYER (UINT16_MAX)
+#define MIND_LATENCY_BUCKETS (64) // log2(ns) buckets
+#define MIND_NO_CARD (UINT16_MAX) // what an empty hand holds, as far as the lowest card tree is concerned
+#define MIND_RNG_BUFFER_SIZE (64) // must be a power of 2 and a multiple of 8
+#define MIND_SHUFFLE_PASSES (7)
+#ifndef MIND_SHUFFLE_MODE
+    #define MIND_SHUFFLE_MODE SHUFFLE_PHYSICAL // or SHUFFLE_SURROGATE, see deckSurrogateShuffle
+#endif
 #ifdef DEBUG_BUILD
     #define MIND_DEBUG(x) do {x} while (0)
 #else
@@ -33,32 +42,59 @@
 typedef struct game_t game_t;
 typedef struct player_t player_t;
 typedef struct stack_t stack_t;
+typedef struct rng_t rng_t;
+typedef struct results_t results_t;
+typedef struct checkpoint_t checkpoint_t;
+typedef struct mind_latency_t mind_latency_t;
+typedef struct mind_stats_t mind_stats_t;
 typedef enum mind_stack_type_t {
     DECK, PILE, HAND    
 } mind_stack_type_t;
+typedef enum mind_shuffle_mode_t {
+    SHUFFLE_PHYSICAL, SHUFFLE_SURROGATE
+} mind_shuffle_mode_t;
 
 //---------------------------------//
 //--------STACK DECLARATION--------//
 //---------------------------------//
 
 struct stack_t {
-    uint8_t *cards;
-    uint8_t *top;
+    uint16_t *cards;
+    uint16_t *top;
     size_t allocd;
 };
 
 void stackCreate(stack_t *stack, size_t sz);
 void stackDestroy(stack_t *stack);
 uint32_t stackGetSize(stack_t *stack);
-void stackPush(stack_t *stack, uint8_t value);
-uint8_t stackPop(stack_t *stack);
+void stackPush(stack_t *stack, uint16_t value);
+uint16_t stackPop(stack_t *stack);
 void stackMove(stack_t *dst, stack_t *src);
-void stackPushN(stack_t *stack, uint8_t *values, size_t n);
-void stackPopN(stack_t *stack, uint8_t *res, size_t n);
+void stackPushN(stack_t *stack, uint16_t *values, size_t n);
+void stackPopN(stack_t *stack, uint16_t *res, size_t n);
 void stackMoveN(stack_t *dst, stack_t *src, size_t n);
-uint8_t stackPeek(stack_t *stack);
+uint16_t stackPeek(stack_t *stack);
 void stackPrint(stack_t *stack, const char *stack_name);
 
+//---------------------------------//
+//---------RNG DECLARATION---------//
+//---------------------------------//
+
+// xorshift128+ running on 4 independent 64 bit lanes (a single AVX2 register).
+// Values are generated MIND_RNG_BUFFER_SIZE at a time, so that randf/randi are just a buffer read.
+struct rng_t {
+    uint64_t s0[4];
+    uint64_t s1[4];
+    float floats[MIND_RNG_BUFFER_SIZE];  // uniform in [0, 1)
+    uint32_t ints[MIND_RNG_BUFFER_SIZE]; // uniform over all 32 bits
+    uint32_t i;                          // next unread slot. MIND_RNG_BUFFER_SIZE or more means "refill first"
+};
+
+void rngCreate(rng_t *rng, uint64_t seed);
+void rngRefill(rng_t *rng);
+uint32_t rngNextSlot(rng_t *rng);
+uint32_t rngBounded(rng_t *rng, uint32_t range);
+
 //--------------------------------//
 //-------PLAYER DECLARATION-------//
 //--------------------------------//
@@ -71,6 +107,7 @@ typedef enum player_effects {
 // threshold & skill are constant (as well as thread, n ofc) throughout the game.
 struct player_t {
     stack_t hand;
+    rng_t rng;                              // the player's own random stream, so threads never share one
     game_t *game;
     thread_t thread;
     float skill;                            // A constant between 0 and 1
@@ -78,16 +115,18 @@ struct player_t {
     uint32_t beat;                          // the player's internal time interval for synchronizing the game. May change during the game.
     uint32_t count;                         // number of beats since the round's start.
     uint32_t timeout[mind_n_player_effects]; // countdown for player effects that shouldn't repeat too often
-    uint8_t pile_card;                       // the player keeps track of the pile's top card.
-    uint8_t last_card_played;               // the last card that this player played
-    uint8_t threshold;                      // the player's threshold for feeling like their smallest card should be played soon.
-    uint8_t n;
+    uint16_t pile_card;                     // the player keeps track of the pile's top card.
+    uint16_t pile_seen;                     // the pile's size when the player last looked at it (for latency)
+    uint16_t last_card_played;              // the last card that this player played
+    uint16_t threshold;                     // the player's threshold for feeling like their smallest card should be played soon.
+    uint16_t n;
 };
 
 void playerCreate(player_t *player, game_t *game);
-void playerDeckShuffle(player_t *player);
+void playerReset(player_t *player);
+void playerDeckShuffle(player_t *player, uint8_t n_passes);
 void playTurn(player_t *player);
-void playerAdjust(player_t *player, uint8_t top_card);
+void playerAdjust(player_t *player, uint16_t top_card);
 void playerBored(player_t *player);
 void playerHesitate(player_t *player);
 void playerConfused(player_t *player);
@@ -96,6 +135,40 @@ void playerFixBeat(player_t *player);
 void playerTryPlay(player_t *player);
 float playerGetError(player_t *player);
 thread_return_t playGame(thread_arg_t _player);
+thread_return_t playPool(thread_arg_t _player);
+
+
+//------------------------------//
+//-----LATENCY DECLARATION------//
+//------------------------------//
+
+// Distribution of the time from a card being played until another player notices it (thread wake up + pile_mtx wait)
+struct mind_latency_t {
+    uint64_t hist[MIND_LATENCY_BUCKETS];    // hist[i] counts latencies in [2^i, 2^(i+1)) ns
+    uint64_t n;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+};
+
+void latencyAdd(mind_latency_t *latency, uint64_t ns);
+void latencyMerge(mind_latency_t *dst, const mind_latency_t *src);
+uint64_t latencyPercentile(const mind_latency_t *latency, double q);
+
+// The outcomes of one level number. Kept per level number, as arrays of MIND_MAX_LEVEL + 1 (see game_t.stats)
+struct mind_stats_t {
+    mind_latency_t latency;
+    uint32_t n_played;
+    uint32_t n_lost;
+    uint32_t n_simulated;                   // levels that were actually played out (not skipped)
+    uint32_t n_simulated_won;
+    double sum_p_win;                       // evaluateLevel's predictions for the simulated levels
+    double sum_weight;                      // level.weight of the simulated levels
+    double sum_weight_won;                  // level.weight of the simulated levels that were won
+};
+
+void statsMerge(mind_stats_t *dst, const mind_stats_t *src);
+void statsLatencyReport(const mind_stats_t *stats, FILE *out);
+void statsEvaluationReport(const mind_stats_t *stats, FILE *out);
 
 
 //------------------------------//
@@ -108,21 +181,64 @@ struct game_t {
     mutex_t pile_mtx;
     mutex_t print_mtx;
     barrier_t barrier;
+    barrier_t pool_barrier;                 // the pool's threads and gamePlay meet here before and after every game
+    bool has_pool;                          // the players' threads are kept between games (see gamePoolStart)
+    bool pool_quit;                         // tells the pool's threads to return instead of playing another game
     struct player_t *players;
-    struct {
+    uint64_t seed;                          // seeds every player's rng
+    mind_shuffle_mode_t shuffle_mode;
+    results_t *results;                     // optional. Every level's outcome is appended to it
+    checkpoint_t *checkpoint;               // optional. The game is saved to it between levels, to be resumed from there
+    atomic_uint_least64_t *heartbeat_ns;    // optional. Set to timeNowNs at every level boundary (see supervisorWorker)
+    float time_scale;                       // multiplies every beat's sleep. 1 = real time
+    uint32_t max_levels;                    // the game is abandoned after this many levels (0 = play until won)
+    float skip_above;                       // levels evaluateLevel rates above this are decided by a coin flip instead of played (1 = never)
+    float skip_sample;                      // the share of those that is played out anyway, to stand in for the rest (see level.weight)
+    uint32_t n_levels_played;
+    uint32_t n_levels_won;
+    uint16_t best_level;                    // highest level won so far
+    atomic_flag should_wait_for_setup;      // the first thread to finish a level sets up the next one
+    atomic_uint_least32_t n_players_ready;
+    bool verbose;                           // print the game's progress to stdout
+    bool won;
+    uint64_t *play_ns;                      // [deck_size] when each card on the pile was played (timeNowNs)
+    uint16_t *pile_owner;                   // [deck_size] who played each card on the pile
+    uint16_t *scratch;                      // [deck_size] the shufflers' spare deck
+    uint16_t **evaluate_next;               // [n_players] evaluateLevel's view of every hand
+    uint32_t *lowest_tree;                  // tournament tree over every hand's lowest card. Nodes are (card << 16) | player
+    uint32_t n_leaves;                      // n_players rounded up to a power of 2
+    atomic_uint_least16_t lowest_card;      // the lowest card in any hand (the tree's root), readable without pile_mtx
+    mind_latency_t level_latency;           // reaction latencies of the current level
+    mind_stats_t stats[MIND_MAX_LEVEL + 1]; // per level number, accumulated over every game played on this struct
+    struct mind_level_t {
         uint16_t n; // The level's number
         uint16_t n_cards;
         bool is_over; // true = over
         bool status; // true = win
+        uint16_t blame_fast; // the player who played too early (MIND_NO_PLAYER if the level was won)
+        uint16_t blame_slow; // the player who held the card that should have been played
+        uint16_t blame_card_fast; // the card blame_fast should have waited for (adjusted for in gameLevelNext)
+        uint16_t blame_card_slow; // the card blame_slow should have played before
+        float p_win; // evaluateLevel's baseline for this deal
+        bool simulated; // false if the level was decided by the evaluator alone (see skip_above)
+        float weight; // importance weight of a simulated level: 1, or 1 / skip_sample above skip_above (0 if not simulated)
     } level;
-    uint8_t n_players;
+    uint16_t n_players;
+    uint16_t deck_size;                     // gameDeckSize(n_players)
 };
 
-void gameCreate(game_t *game, uint8_t n_players);
+uint16_t gameDeckSize(uint16_t n_players);
+void gameCreate(game_t *game, uint16_t n_players);
+void gameReset(game_t *game, uint64_t seed);
+void gamePlay(game_t *game);
 void gameDestroy(game_t *game);
+void gamePoolStart(game_t *game);
+void gamePoolStop(game_t *game);
 void gameLevelSetup(game_t *game, uint8_t n_level);
 void gameLevelNext(game_t *game);
 void gameAssignBlame(game_t *game);
+void gameLowestBuild(game_t *game);
+void gameLowestUpdate(game_t *game, uint16_t i_player);
 void gameLog(game_t *game, mind_stack_type_t type, ...);
 
 //---------------------------//
@@ -132,7 +248,11 @@ void gameLog(game_t *game, mind_stack_type_t type, ...);
 int reverseCompare (const void *arg1, const void *arg2);
 void deckRuffle(stack_t *deck, player_t *player);
 void deckMultiCut(stack_t *stack, player_t *player);
-void deckShmush(stack_t *deck);
-float randf(float min, float max);
-uint32_t randi(uint32_t n, float err);
+void deckShmush(stack_t *deck, player_t *player);
+void deckSurrogateShuffle(stack_t *deck, player_t *player, uint8_t n_passes);
+bool shuffleValidate(uint32_t n_samples, uint64_t seed);
+float randf(rng_t *rng, float min, float max);
+uint32_t randi(rng_t *rng, uint32_t n, float err);
+uint64_t splitMix64(uint64_t *state);
+uint64_t timeNowNs(void);
 unsigned int trueRand(void);
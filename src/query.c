@@ -0,0 +1,258 @@
+#include "results.h"
+
+#define QUERY_MAX_GROUPS (0x10000)
+#define QUERY_MAX_FILTERS (8)
+#define QUERY_MAX_FILES (0x1000)
+
+// "min_skill" / "max_skill" aren't stored; they are computed from the skill_N columns, but only when a query uses them
+typedef enum query_source_t {
+    COLUMN, MIN_SKILL, MAX_SKILL
+} query_source_t;
+
+typedef struct query_operand_t {
+    query_source_t source;
+    int i_column;           // index into the columns the query decodes (COLUMN only)
+} query_operand_t;
+
+typedef struct query_filter_t {
+    query_operand_t operand;
+    char op;                // '<', '>' or '='
+    double value;
+} query_filter_t;
+
+typedef struct query_t {
+    results_reader_t reader;
+    int columns[RESULTS_MAX_COLUMNS];   // the file columns that have to be decoded
+    uint32_t n_columns;
+    int skill_columns[MIND_MAX_PLAYERS]; // where skill_N is in 'columns', if min/max_skill are needed
+    bool has_skills;
+    query_operand_t group;
+    query_operand_t aggregate;
+    query_filter_t filters[QUERY_MAX_FILTERS];
+    uint32_t n_filters;
+} query_t;
+
+bool queryOpen(query_t *query, const char *path);
+bool queryParseOperand(query_t *query, const char *name, query_operand_t *operand);
+int queryUseColumn(query_t *query, int i_file_column);
+double queryEvaluate(query_t *query, query_operand_t *operand, uint64_t **values, uint32_t row);
+
+
+/// @brief Scans results files and prints count and mean of one column grouped by another, e.g. the win rate by level:
+///        query results.mind level status "min_skill<0.7"
+/// @param argc at least 4
+/// @param argv files (comma separated, e.g. a sweep's worker files; all with the same columns), group by column,
+///             aggregated column, then up to QUERY_MAX_FILTERS filters like "beat_0>150"
+int main(int argc, char **argv) {
+    if (argc < 4 || argc - 4 > QUERY_MAX_FILTERS) {
+        fprintf(stderr, "usage: %s <results file>[,<results file>...] <group by> <mean of> [<column><|>|=<value> ...]\n"
+                        "columns: seed, level, status, cards_left, blame_fast, blame_slow, latency_mean, latency_max (us),\n"
+                        "         p_win, simulated,\n"
+                        "         skill_N, beat_N, min_skill, max_skill\n",
+                argv[0]);
+        return 1;
+    }
+
+    char *paths[QUERY_MAX_FILES];
+    uint32_t n_paths = 0;
+    for (char *path = strtok(argv[1], ","); path != NULL; path = strtok(NULL, ",")) {
+        if (n_paths == QUERY_MAX_FILES) {
+            fprintf(stderr, "Can only query up to %d files at once\n", QUERY_MAX_FILES);
+            return 1;
+        }
+        paths[n_paths++] = path;
+    }
+    // the columns are resolved against the first file with a header, and every other one has to have the very same
+    query_t query = {0};
+    uint32_t i_first = 0;
+    bool opened = false;
+    while (i_first < n_paths && (opened = queryOpen(&query, paths[i_first])) && query.reader.header == NULL) {
+        i_first++;
+    }
+    if (!opened || i_first == n_paths) {
+        fprintf(stderr, "Can't read %s\n", (i_first < n_paths)? paths[i_first]: argv[1]);
+        return 1;
+    }
+    size_t header_sz = resultsHeaderSize(query.reader.header->n_columns);
+    results_header_t *header = malloc(header_sz);
+    if (header == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+    memcpy(header, query.reader.header, header_sz);
+
+    if (!queryParseOperand(&query, argv[2], &query.group) || !queryParseOperand(&query, argv[3], &query.aggregate)) {
+        return 1;
+    }
+    for (int i = 4; i < argc; i++) {
+        query_filter_t *filter = &query.filters[query.n_filters++];
+        char name[RESULTS_NAME_LEN] = {0};
+        size_t len = strcspn(argv[i], "<>=");
+        if (len >= RESULTS_NAME_LEN || argv[i][len] == '\0') {
+            fprintf(stderr, "Bad filter: %s\n", argv[i]);
+            return 1;
+        }
+        memcpy(name, argv[i], len);
+        filter->op = argv[i][len];
+        filter->value = atof(argv[i] + len + 1);
+        if (!queryParseOperand(&query, name, &filter->operand)) {
+            return 1;
+        }
+    }
+
+    uint64_t **values = malloc(sizeof(*values) * query.n_columns);
+    double *count = calloc(QUERY_MAX_GROUPS, sizeof(*count));
+    double *sum = calloc(QUERY_MAX_GROUPS, sizeof(*sum));
+    if (values == NULL || count == NULL || sum == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < query.n_columns; i++) {
+        values[i] = malloc(sizeof(**values) * RESULTS_BLOCK_ROWS);
+        if (values[i] == NULL) {
+            fprintf(stderr, "Out of memory!");
+            exit(1);
+        }
+    }
+
+    uint64_t n_scanned = 0;
+    for (uint32_t i_path = i_first; i_path < n_paths; i_path++) {
+        if (i_path > i_first) {
+            resultsClose(&query.reader);
+            if (!queryOpen(&query, paths[i_path])) {
+                fprintf(stderr, "Can't read %s\n", paths[i_path]);
+                return 1;
+            }
+            if (query.reader.header == NULL) continue;
+            if (query.reader.header->n_columns != header->n_columns || memcmp(query.reader.header, header, header_sz)) {
+                fprintf(stderr, "%s doesn't have the same columns as %s\n", paths[i_path], paths[i_first]);
+                return 1;
+            }
+        }
+        uint32_t n_rows;
+        while ((n_rows = resultsReadBlock(&query.reader, query.columns, query.n_columns, values))) {
+            n_scanned += n_rows;
+            for (uint32_t row = 0; row < n_rows; row++) {
+                bool keep = true;
+                for (uint32_t i = 0; i < query.n_filters && keep; i++) {
+                    query_filter_t *filter = &query.filters[i];
+                    double v = queryEvaluate(&query, &filter->operand, values, row);
+                    keep = (filter->op == '<')? v < filter->value: (filter->op == '>')? v > filter->value: v == filter->value;
+                }
+                if (!keep) continue;
+
+                double group = queryEvaluate(&query, &query.group, values, row);
+                if (group < 0 || group >= QUERY_MAX_GROUPS) {
+                    fprintf(stderr, "Can only group by integers from 0 to %d\n", QUERY_MAX_GROUPS - 1);
+                    return 1;
+                }
+                count[(uint32_t)group]++;
+                sum[(uint32_t)group] += queryEvaluate(&query, &query.aggregate, values, row);
+            }
+        }
+        if (query.reader.offset < query.reader.size) {
+            fprintf(stderr, "%s: the last %llu bytes aren't a whole block and were ignored (the writer was interrupted?)\n",
+                    paths[i_path], (unsigned long long)(query.reader.size - query.reader.offset));
+        }
+    }
+
+    printf("%-12s %14s %14s\n", argv[2], "rows", argv[3]);
+    for (uint32_t group = 0; group < QUERY_MAX_GROUPS; group++) {
+        if (count[group] == 0) continue;
+        printf("%-12u %14.0f %14.4f\n", group, count[group], sum[group] / count[group]);
+    }
+    printf("(%llu rows scanned)\n", (unsigned long long)n_scanned);
+
+    for (uint32_t i = 0; i < query.n_columns; i++) {
+        free(values[i]);
+    }
+    free(values);
+    free(header);
+    free(count);
+    free(sum);
+    resultsClose(&query.reader);
+    return 0;
+}
+
+/// @brief Opens one of the query's files. A file that exists but is too short for a header (its writer died before it
+///        got that far) has no rows: it is reported and left closed, with a NULL header
+/// @param query pointer to the query
+/// @param path the results file
+/// @return false if the file can't be read or isn't a results file
+bool queryOpen(query_t *query, const char *path) {
+    if (resultsOpen(&query->reader, path)) return true;
+
+    // the header's size depends on its n_columns, if the file got that far
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+    struct stat st;
+    results_header_t header;
+    bool has_fixed = fread(&header, sizeof(header), 1, file) == 1;
+    bool failed = fstat(fileno(file), &st);
+    fclose(file);
+    if (failed || (has_fixed && (memcmp(header.magic, RESULTS_MAGIC, sizeof(header.magic)) || header.n_columns > RESULTS_MAX_COLUMNS ||
+                                 (size_t)st.st_size >= resultsHeaderSize(header.n_columns)))) {
+        return false;
+    }
+    fprintf(stderr, "%s: no complete header, so no rows either (the writer was interrupted?)\n", path);
+    return true;
+}
+
+/// @brief Resolves a column name (or min_skill / max_skill) and marks the file columns it needs for decoding
+/// @param query pointer to the query
+/// @param name the column's name
+/// @param operand filled in with where the operand's values come from
+/// @return false if there is no such column
+bool queryParseOperand(query_t *query, const char *name, query_operand_t *operand) {
+    bool is_min = !strcmp(name, "min_skill");
+    if (is_min || !strcmp(name, "max_skill")) {
+        *operand = (query_operand_t) {.source = is_min? MIN_SKILL: MAX_SKILL};
+        for (uint32_t i = 0; i < query->reader.header->n_players && !query->has_skills; i++) {
+            char skill_name[RESULTS_NAME_LEN];
+            sprintf_s(skill_name, RESULTS_NAME_LEN, "skill_%u", i);
+            query->skill_columns[i] = queryUseColumn(query, resultsColumnIndex(&query->reader, skill_name));
+        }
+        query->has_skills = true;
+        return true;
+    }
+
+    int i_file_column = resultsColumnIndex(&query->reader, name);
+    if (i_file_column < 0) {
+        fprintf(stderr, "Unknown column: %s\n", name);
+        return false;
+    }
+    *operand = (query_operand_t) {.source = COLUMN, .i_column = queryUseColumn(query, i_file_column)};
+    return true;
+}
+
+/// @brief Adds a file column to the set of columns that get decoded (once)
+/// @param query pointer to the query
+/// @param i_file_column the column's index in the file
+/// @return the column's index in the query's decoded values
+int queryUseColumn(query_t *query, int i_file_column) {
+    for (uint32_t i = 0; i < query->n_columns; i++) {
+        if (query->columns[i] == i_file_column) return i;
+    }
+    query->columns[query->n_columns] = i_file_column;
+    return query->n_columns++;
+}
+
+/// @brief Gets an operand's value for one row of the current block
+/// @param query pointer to the query
+/// @param operand the operand
+/// @param values the decoded columns of the current block
+/// @param row the row within the block
+/// @return the value
+double queryEvaluate(query_t *query, query_operand_t *operand, uint64_t **values, uint32_t row) {
+    if (operand->source == COLUMN) {
+        return resultsValue(&query->reader, query->columns[operand->i_column], values[operand->i_column][row]);
+    }
+
+    double res = (operand->source == MIN_SKILL)? INFINITY: -INFINITY;
+    for (uint32_t i = 0; i < query->reader.header->n_players; i++) {
+        int i_column = query->skill_columns[i];
+        double skill = resultsValue(&query->reader, query->columns[i_column], values[i_column][row]);
+        res = (operand->source == MIN_SKILL)? fmin(res, skill): fmax(res, skill);
+    }
+    return res;
+}
@@ -0,0 +1,355 @@
+#include "results.h"
+
+
+//---------------------------------//
+//-------WRITER IMPLEMENTATION-----//
+//---------------------------------//
+
+/// @brief Creates a results file and writes its header, straight to the file. Column buffers are malloc'd once, here
+/// @param results pointer to a results struct. The shallow memory of the results struct is managed by the caller
+/// @param path the file to (over)write
+/// @param n_players the number of players in every game that will be appended
+/// @return false if the file could not be opened or its header could not be written
+bool resultsCreate(results_t *results, const char *path, uint16_t n_players) {
+    return resultsAppend(results, path, n_players, 0);
+}
+
+/// @brief Reopens a results file to append to it, cut back to the first 'size' bytes it had (a results_t.size it went
+///        through): whatever was written after that is dropped. A size of 0 creates the file, like resultsCreate
+/// @param results pointer to a results struct. The shallow memory of the results struct is managed by the caller
+/// @param path the file to append to
+/// @param n_players the number of players in every game that was and will be appended
+/// @param size where the file is cut, 0 to (over)write it
+/// @return false if the file could not be opened or written, or is shorter than size, or has another header
+bool resultsAppend(results_t *results, const char *path, uint16_t n_players, uint64_t size) {
+    static const char *fixed_names[RESULTS_N_FIXED_COLUMNS] = {
+        "seed", "level", "status", "cards_left", "blame_fast", "blame_slow", "latency_mean", "latency_max",
+        "p_win", "simulated"
+    };
+
+    uint32_t n_columns = RESULTS_N_FIXED_COLUMNS + 2 * n_players;
+    *results = (results_t) {
+        .file = fopen(path, (size)? "r+b": "wb"),
+        .header = calloc(1, resultsHeaderSize(n_columns)),
+        .size = (size)? size: resultsHeaderSize(n_columns)
+    };
+    if (results->header == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+    if (results->file == NULL) {
+        free(results->header);
+        results->header = NULL;
+        return false;
+    }
+
+    results_header_t *header = results->header;
+    memcpy(header->magic, RESULTS_MAGIC, sizeof(header->magic));
+    header->n_columns = n_columns;
+    header->n_players = n_players;
+    for (uint32_t i = 0; i < RESULTS_N_FIXED_COLUMNS; i++) {
+        strcpy_s(header->columns[i].name, RESULTS_NAME_LEN, fixed_names[i]);
+        header->columns[i].type = RESULTS_INT;
+    }
+    header->columns[8].type = RESULTS_FLOAT; // p_win
+    for (uint32_t i = 0; i < n_players; i++) {
+        uint32_t i_skill = RESULTS_N_FIXED_COLUMNS + i;
+        uint32_t i_beat = RESULTS_N_FIXED_COLUMNS + n_players + i;
+        sprintf_s(header->columns[i_skill].name, RESULTS_NAME_LEN, "skill_%u", i);
+        header->columns[i_skill].type = RESULTS_FLOAT;
+        sprintf_s(header->columns[i_beat].name, RESULTS_NAME_LEN, "beat_%u", i);
+        header->columns[i_beat].type = RESULTS_INT;
+    }
+
+    uint32_t block_rows = RESULTS_BLOCK_BYTES / ((sizeof(*results->columns) + RESULTS_MAX_VARINT) * header->n_columns);
+    results->block_rows = (block_rows < RESULTS_BLOCK_ROWS)? block_rows: RESULTS_BLOCK_ROWS;
+    results->columns = malloc(sizeof(*results->columns) * results->block_rows * header->n_columns);
+    results->scratch = malloc(sizeof(uint32_t) * (1 + header->n_columns) + RESULTS_MAX_VARINT * results->block_rows * header->n_columns);
+    if (results->columns == NULL || results->scratch == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+
+    // a new file's header is flushed right away: a reader can't make sense of any block without it. An existing file's
+    // has to be the same, and it is what the cut leaves at least
+    bool ok;
+    if (size == 0) {
+        ok = fwrite(header, resultsHeaderSize(n_columns), 1, results->file) == 1 && !fflush(results->file);
+    } else {
+        struct stat st;
+        ok = !fstat(fileno(results->file), &st) && (uint64_t)st.st_size >= size && size >= resultsHeaderSize(n_columns) &&
+             fread(results->scratch, resultsHeaderSize(n_columns), 1, results->file) == 1 &&
+             !memcmp(results->scratch, header, resultsHeaderSize(n_columns)) &&
+             !ftruncate(fileno(results->file), size) && !fseek(results->file, size, SEEK_SET);
+    }
+    if (!ok) {
+        fclose(results->file);
+        free(results->header);
+        free(results->columns);
+        free(results->scratch);
+        *results = (results_t) {0};
+        return false;
+    }
+    return true;
+}
+
+/// @brief Writes out whatever is left in the current block, closes the file and frees the buffers
+/// @param results pointer to a results struct
+/// @return false if any write to the file failed, now or before
+bool resultsDestroy(results_t *results) {
+    if (results->file == NULL) return true;
+
+    bool ok = resultsFlush(results);
+    ok &= !fclose(results->file);
+    free(results->header);
+    free(results->columns);
+    free(results->scratch);
+    results->file = NULL;
+    return ok;
+}
+
+/// @brief Records the outcome of the level that was just played. Call before the hands go back to the deck
+/// @param results pointer to a results struct
+/// @param game pointer to the game struct
+void resultsAppendLevel(results_t *results, game_t *game) {
+    uint64_t *row = results->columns + results->n_rows;
+    const uint32_t stride = results->block_rows;
+    uint16_t n_players = results->header->n_players;
+
+    row[0 * stride] = game->seed;
+    row[1 * stride] = game->level.n;
+    row[2 * stride] = game->level.status;
+    row[3 * stride] = game->level.n_cards;
+    row[4 * stride] = game->level.blame_fast;
+    row[5 * stride] = game->level.blame_slow;
+    row[6 * stride] = (game->level_latency.n)? game->level_latency.sum_ns / game->level_latency.n / 1000: 0; // us
+    row[7 * stride] = game->level_latency.max_ns / 1000;
+    uint32_t p_win_bits;
+    memcpy(&p_win_bits, &game->level.p_win, sizeof(p_win_bits));
+    row[8 * stride] = p_win_bits;
+    row[9 * stride] = game->level.simulated;
+    for (uint16_t i = 0; i < n_players; i++) {
+        uint32_t skill_bits;
+        memcpy(&skill_bits, &game->players[i].skill, sizeof(skill_bits));
+        row[(RESULTS_N_FIXED_COLUMNS + i) * stride] = skill_bits;
+        row[(RESULTS_N_FIXED_COLUMNS + n_players + i) * stride] = game->players[i].beat;
+    }
+
+    if (++results->n_rows == results->block_rows) {
+        resultsFlush(results); // a failure sticks, for whoever flushes or destroys next
+    }
+    return;
+}
+
+/// @brief Encodes the current block and writes it with a single sequential write, then hands it to the OS (fflush)
+/// @param results pointer to a results struct
+/// @return false if this or any earlier write failed. After a failure nothing more is written, so the file stays a
+///         sequence of whole blocks (a partial block that made it to disk is ignored by readers)
+bool resultsFlush(results_t *results) {
+    if (results->failed) {
+        results->n_rows = 0;
+        return false;
+    }
+    if (results->n_rows == 0) return true;
+
+    uint32_t n_columns = results->header->n_columns;
+    uint32_t *block_header = (uint32_t *)results->scratch;
+    uint8_t *data = results->scratch + sizeof(uint32_t) * (1 + n_columns);
+    size_t sz = 0;
+
+    block_header[0] = results->n_rows;
+    for (uint32_t i = 0; i < n_columns; i++) {
+        size_t column_sz = resultsEncodeColumn(data + sz, results->columns + (size_t)i * results->block_rows,
+                                               results->n_rows, results->header->columns[i].type);
+        block_header[1 + i] = (uint32_t)column_sz;
+        sz += column_sz;
+    }
+
+    size_t block_sz = sizeof(uint32_t) * (1 + n_columns) + sz;
+    results->failed = fwrite(results->scratch, 1, block_sz, results->file) != block_sz || fflush(results->file);
+    results->size += (results->failed)? 0: block_sz;
+    results->n_rows = 0;
+    return !results->failed;
+}
+
+
+//---------------------------------//
+//-------READER IMPLEMENTATION-----//
+//---------------------------------//
+
+/// @brief Maps a results file into memory (read only)
+/// @param reader pointer to a reader struct. The shallow memory of the reader struct is managed by the caller
+/// @param path the results file
+/// @return false if the file can't be mapped or isn't a results file
+bool resultsOpen(results_reader_t *reader, const char *path) {
+    *reader = (results_reader_t) {0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(results_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    reader->map = map;
+    reader->size = st.st_size;
+    reader->header = map;
+
+    if (memcmp(reader->header->magic, RESULTS_MAGIC, sizeof(reader->header->magic)) ||
+        reader->header->n_columns > RESULTS_MAX_COLUMNS || reader->size < resultsHeaderSize(reader->header->n_columns)) {
+        resultsClose(reader);
+        return false;
+    }
+    reader->offset = resultsHeaderSize(reader->header->n_columns);
+    return true;
+}
+
+/// @brief Unmaps a results file
+/// @param reader pointer to a reader struct
+void resultsClose(results_reader_t *reader) {
+    if (reader->map != NULL) {
+        munmap((void *)reader->map, reader->size);
+    }
+    *reader = (results_reader_t) {0};
+    return;
+}
+
+/// @brief Looks up a column by name
+/// @param reader pointer to a reader struct
+/// @param name e.g. "level" or "skill_0"
+/// @return the column's index, -1 if there is no such column
+int resultsColumnIndex(results_reader_t *reader, const char *name) {
+    for (uint32_t i = 0; i < reader->header->n_columns; i++) {
+        if (!strncmp(reader->header->columns[i].name, name, RESULTS_NAME_LEN)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// @brief Decodes the requested columns of the next block. The other columns are skipped without being read
+/// @param reader pointer to a reader struct
+/// @param i_columns the indices of the columns to decode
+/// @param n the number of columns to decode
+/// @param values one array of RESULTS_BLOCK_ROWS values per requested column
+/// @return the number of rows decoded; 0 once there are no more (complete) blocks
+uint32_t resultsReadBlock(results_reader_t *reader, const int *i_columns, uint32_t n, uint64_t **values) {
+    uint32_t n_columns = reader->header->n_columns;
+    size_t header_sz = sizeof(uint32_t) * (1 + n_columns);
+    if (reader->offset + header_sz > reader->size) return 0;
+
+    uint32_t block_header[1 + RESULTS_MAX_COLUMNS];
+    memcpy(block_header, reader->map + reader->offset, header_sz);
+    uint32_t n_rows = block_header[0];
+
+    size_t column_offsets[RESULTS_MAX_COLUMNS];
+    size_t data_sz = 0;
+    for (uint32_t i = 0; i < n_columns; i++) {
+        column_offsets[i] = data_sz;
+        data_sz += block_header[1 + i];
+    }
+    // a truncated last block (e.g. the writer was killed) is ignored
+    if (n_rows > RESULTS_BLOCK_ROWS || reader->offset + header_sz + data_sz > reader->size) return 0;
+
+    const uint8_t *data = reader->map + reader->offset + header_sz;
+    for (uint32_t i = 0; i < n; i++) {
+        int c = i_columns[i];
+        resultsDecodeColumn(data + column_offsets[c], block_header[1 + c], values[i], n_rows, reader->header->columns[c].type);
+    }
+
+    reader->offset += header_sz + data_sz;
+    return n_rows;
+}
+
+/// @brief Converts a decoded value to a double, according to its column's type
+/// @param reader pointer to a reader struct
+/// @param i_column the value's column
+/// @param value as returned by resultsReadBlock
+/// @return the value
+double resultsValue(results_reader_t *reader, int i_column, uint64_t value) {
+    if (reader->header->columns[i_column].type == RESULTS_FLOAT) {
+        uint32_t bits = (uint32_t)value;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+    return (double)value;
+}
+
+
+//---------------------------//
+//-----------UTILS-----------//
+//---------------------------//
+
+/// @brief The size of a results header, columns included
+/// @param n_columns the header's number of columns
+/// @return the size in bytes, which is also where the first block starts
+size_t resultsHeaderSize(uint32_t n_columns) {
+    return sizeof(results_header_t) + sizeof(results_column_t) * n_columns;
+}
+
+/// @brief Delta (ints) or xor (floats) encodes a column, then stores the zigzagged results as varints
+/// @param dst where the encoded bytes go. Must have room for RESULTS_MAX_VARINT bytes per value
+/// @param values the column's values
+/// @param n the number of values
+/// @param type RESULTS_INT or RESULTS_FLOAT
+/// @return the number of bytes written
+size_t resultsEncodeColumn(uint8_t *dst, const uint64_t *values, uint32_t n, results_column_type_t type) {
+    uint8_t *p = dst;
+    uint64_t prev = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t v;
+        if (type == RESULTS_FLOAT) {
+            v = values[i] ^ prev;
+        } else {
+            int64_t delta = (int64_t)(values[i] - prev);
+            v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+        }
+        prev = values[i];
+
+        while (v >= 0x80) {
+            *p++ = (uint8_t)v | 0x80;
+            v >>= 7;
+        }
+        *p++ = (uint8_t)v;
+    }
+    return p - dst;
+}
+
+/// @brief Reverses resultsEncodeColumn
+/// @param src the encoded bytes
+/// @param sz the number of encoded bytes
+/// @param values where the decoded values go
+/// @param n the number of values to decode
+/// @param type RESULTS_INT or RESULTS_FLOAT
+/// @return the number of bytes read
+size_t resultsDecodeColumn(const uint8_t *src, size_t sz, uint64_t *values, uint32_t n, results_column_type_t type) {
+    const uint8_t *p = src;
+    const uint8_t *end = src + sz;
+    uint64_t prev = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; p < end; shift += 7) {
+            uint8_t byte = *p++;
+            v |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+
+        if (type == RESULTS_FLOAT) {
+            prev ^= v;
+        } else {
+            prev += (v >> 1) ^ -(v & 1);
+        }
+        values[i] = prev;
+    }
+    return p - src;
+}
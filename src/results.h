@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mind.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define RESULTS_MAGIC "MINDRES2"
+#define RESULTS_BLOCK_ROWS (1 << 16) // at most; a writer's blocks are as many rows as fit in RESULTS_BLOCK_BYTES
+#define RESULTS_BLOCK_BYTES (1 << 20) // what a writer's buffers may take, at 8 + RESULTS_MAX_VARINT bytes per value
+#define RESULTS_N_FIXED_COLUMNS (10)
+#define RESULTS_MAX_COLUMNS (RESULTS_N_FIXED_COLUMNS + 2 * MIND_MAX_PLAYERS) // fixed columns + skill & beat per player
+#define RESULTS_NAME_LEN (16)
+#define RESULTS_MAX_VARINT (10) // bytes needed to encode any uint64_t
+
+// File layout: results_header_t and its n_columns columns (resultsHeaderSize bytes), then blocks of up to RESULTS_BLOCK_ROWS rows each.
+// Block layout: uint32_t n_rows, uint32_t encoded size of every column, then the columns one after the other.
+// Every column is delta encoded (floats: xor with the previous bit pattern), zigzagged and stored as varints,
+// so a reader can jump straight to the columns it needs and never touches the rest.
+
+typedef enum results_column_type_t {
+    RESULTS_INT, RESULTS_FLOAT
+} results_column_type_t;
+
+typedef struct results_column_t {
+    char name[RESULTS_NAME_LEN];
+    uint32_t type;
+} results_column_t;
+
+typedef struct results_header_t {
+    char magic[8];
+    uint32_t n_columns;
+    uint32_t n_players;
+    results_column_t columns[];             // n_columns
+} results_header_t;
+
+//---------------------------------//
+//-------WRITER DECLARATION--------//
+//---------------------------------//
+
+// One row per level played. Not thread safe: a single thread appends (see gameLevelNext).
+// Write errors are sticky: once one happened, 'failed' stays set and resultsFlush / resultsDestroy return false.
+struct results_t {
+    FILE *file;
+    results_header_t *header;   // resultsHeaderSize(header->n_columns) bytes
+    uint64_t *columns;      // block_rows values per column, column after column
+    uint8_t *scratch;       // the encoded block, written out in one go
+    uint32_t block_rows;    // rows per block
+    uint32_t n_rows;        // rows in the current block
+    bool failed;            // a write failed (e.g. the disk is full); the file ends with the last block written whole
+    uint64_t size;          // the file's size as of the last block written whole (see resultsAppend)
+};
+
+bool resultsCreate(results_t *results, const char *path, uint16_t n_players);
+bool resultsAppend(results_t *results, const char *path, uint16_t n_players, uint64_t size);
+bool resultsDestroy(results_t *results);
+void resultsAppendLevel(results_t *results, game_t *game);
+bool resultsFlush(results_t *results);
+
+//---------------------------------//
+//-------READER DECLARATION--------//
+//---------------------------------//
+
+typedef struct results_reader_t {
+    const uint8_t *map;
+    size_t size;
+    const results_header_t *header;
+    size_t offset;          // where the next block starts
+} results_reader_t;
+
+bool resultsOpen(results_reader_t *reader, const char *path);
+void resultsClose(results_reader_t *reader);
+int resultsColumnIndex(results_reader_t *reader, const char *name);
+uint32_t resultsReadBlock(results_reader_t *reader, const int *i_columns, uint32_t n, uint64_t **values);
+double resultsValue(results_reader_t *reader, int i_column, uint64_t value);
+
+//---------------------------//
+//-----------UTILS-----------//
+//---------------------------//
+
+size_t resultsHeaderSize(uint32_t n_columns);
+size_t resultsEncodeColumn(uint8_t *dst, const uint64_t *values, uint32_t n, results_column_type_t type);
+size_t resultsDecodeColumn(const uint8_t *src, size_t sz, uint64_t *values, uint32_t n, results_column_type_t type);
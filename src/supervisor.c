@@ -0,0 +1,273 @@
+#include "supervisor.h"
+
+
+/// @brief Sets up the shards and the shared memory for the rings. The caller's params.results is ignored: a file can't be
+///        shared by processes, so every worker writes its own (see results_path). With params.checkpoint, every shard
+///        starts from its last committed progress, and the stats from those of the games it covers
+/// @param supervisor pointer to a supervisor struct. The shallow memory of the supervisor struct is managed by the caller
+/// @param params the parameters every game is played with
+/// @param seed the batch's seed
+/// @param n_games the number of games in the batch
+/// @param n_workers the number of worker processes
+/// @param shard_size the number of games handed to a worker at a time
+/// @param hang_ms how long a worker may go without finishing a level before it is considered hung (see supervisorLevelMs)
+/// @param results_path optional (NULL). Where the shards' results files go, with the shard's index as the extension
+/// @return false if the shared memory could not be set up, or the checkpoint is for another batch
+bool supervisorCreate(supervisor_t *supervisor, const mind_params_t *params, uint64_t seed, uint64_t n_games,
+                      uint32_t n_workers, uint32_t shard_size, uint32_t hang_ms, const char *results_path) {
+    checkpoint_t *checkpoint = params->checkpoint;
+    if (checkpoint != NULL && (checkpoint->header->seed != seed || checkpoint->header->n_games != n_games ||
+                               checkpoint->header->shard_size != shard_size)) {
+        return false;
+    }
+
+    *supervisor = (supervisor_t) {
+        .params = *params,
+        .seed = seed,
+        .n_games = n_games,
+        .hang_ms = hang_ms,
+        .n_workers = n_workers,
+        .n_shards = (n_games + shard_size - 1) / shard_size,
+        .results_path = results_path,
+        .pid = getpid()
+    };
+    supervisor->params.results = NULL;
+    if (checkpoint != NULL) {
+        memcpy(supervisor->stats, checkpointStats(checkpoint), sizeof(supervisor->stats));
+    }
+
+    char name[0x40];
+    sprintf_s(name, sizeof(name), "/mind_supervisor_%d", (int)getpid());
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    shm_unlink(name); // the mapping outlives the name, and forked workers inherit it
+
+    size_t sz = sizeof(*supervisor->rings) * n_workers;
+    void *map = MAP_FAILED;
+    if (!ftruncate(fd, sz)) {
+        map = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    supervisor->rings = map;
+
+    supervisor->workers = calloc(n_workers, sizeof(*supervisor->workers));
+    supervisor->shards = malloc(sizeof(*supervisor->shards) * supervisor->n_shards);
+    if (supervisor->workers == NULL || supervisor->shards == NULL) {
+        fprintf(stderr, "Out of memory!");
+        exit(1);
+    }
+    for (uint64_t i = 0; i < supervisor->n_shards; i++) {
+        uint64_t first = i * shard_size;
+        supervisor->shards[i] = (supervisor_shard_t) {
+            .next = (checkpoint != NULL)? checkpointNext(checkpoint, i): first,
+            .end = (first + shard_size < n_games)? first + shard_size: n_games,
+            .results_size = (checkpoint != NULL)? checkpointResultsSize(checkpoint, i): 0
+        };
+    }
+    return true;
+}
+
+/// @brief Kills any worker that is still running and releases the shared memory
+/// @param supervisor pointer to a supervisor struct
+void supervisorDestroy(supervisor_t *supervisor) {
+    for (uint32_t i = 0; i < supervisor->n_workers; i++) {
+        if (supervisor->workers[i].pid) {
+            kill(supervisor->workers[i].pid, SIGKILL);
+            waitpid(supervisor->workers[i].pid, NULL, 0);
+        }
+    }
+    munmap(supervisor->rings, sizeof(*supervisor->rings) * supervisor->n_workers);
+    free(supervisor->workers);
+    free(supervisor->shards);
+    return;
+}
+
+/// @brief Plays every game of the batch. Returns once all of them were reported (or given up on, see 'failed')
+/// @param supervisor pointer to a supervisor struct
+/// @param results caller owned array of n_games results, indexed by game
+void supervisorRun(supervisor_t *supervisor, mind_game_result_t *results) {
+    bool busy = true;
+
+    while (busy) {
+        busy = false;
+        for (uint32_t i = 0; i < supervisor->n_workers; i++) {
+            supervisor_worker_t *worker = &supervisor->workers[i];
+            supervisor_ring_t *ring = &supervisor->rings[i];
+
+            if (worker->pid == 0) {
+                // shards a checkpoint has as finished are skipped
+                while (supervisor->i_next_shard < supervisor->n_shards &&
+                       supervisor->shards[supervisor->i_next_shard].next == supervisor->shards[supervisor->i_next_shard].end) {
+                    supervisor->i_next_shard++;
+                }
+                if (supervisor->i_next_shard == supervisor->n_shards) continue;
+                worker->shard = &supervisor->shards[supervisor->i_next_shard++];
+                supervisorStart(supervisor, i);
+            }
+            busy = true;
+            supervisorDrain(supervisor, i, results);
+
+            int status;
+            bool hung = timeNowNs() - atomic_load(&ring->heartbeat_ns) > supervisor->hang_ms * 1000000ULL;
+            if (hung) {
+                kill(worker->pid, SIGKILL);
+            }
+            if (waitpid(worker->pid, &status, hung? 0: WNOHANG) != worker->pid) continue;
+
+            // The worker is gone. Anything it managed to report still counts
+            supervisorDrain(supervisor, i, results);
+            supervisor_shard_t *shard = worker->shard;
+            worker->pid = 0;
+            if (shard->next == shard->end) continue;
+
+            // It died mid shard: restart it where it left off, unless this very game keeps killing it
+            supervisor->n_restarts++;
+            if (++shard->n_retries > SUPERVISOR_MAX_RETRIES) {
+                results[shard->next] = (mind_game_result_t) {
+                    .seed = batchGameSeed(supervisor->seed, shard->next),
+                    .failed = true
+                };
+                shard->next++;
+                shard->n_retries = 0;
+            }
+            if (shard->next < shard->end) {
+                supervisorStart(supervisor, i);
+            }
+        }
+        if (supervisor->params.checkpoint != NULL && checkpointDue(supervisor->params.checkpoint)) {
+            supervisorCheckpoint(supervisor);
+        }
+        SLEEP(1);
+    }
+
+    if (supervisor->params.checkpoint != NULL) {
+        supervisorCheckpoint(supervisor);
+    }
+    return;
+}
+
+/// @brief Forks a worker for the worker's (remaining) shard
+/// @param supervisor pointer to a supervisor struct
+/// @param i_worker which worker
+void supervisorStart(supervisor_t *supervisor, uint32_t i_worker) {
+    supervisor_ring_t *ring = &supervisor->rings[i_worker];
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->heartbeat_ns, timeNowNs());
+
+    fflush(stdout); // or the child would print the parent's buffered output again
+    pid_t pid = fork();
+    if (pid < 0) {
+        _threads_api_Panik("fork failed!");
+    } else if (pid == 0) {
+        // die with the supervisor: an orphaned worker would play on unheard, and keep writing to the checkpoint.
+        // The supervisor may have died before the prctl, hence the check after it
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != supervisor->pid) _exit(1);
+        // the checkpoint's lock is the supervisor's: a worker that outlives it must not keep the next run out
+        if (supervisor->params.checkpoint != NULL) {
+            close(supervisor->params.checkpoint->fd);
+        }
+        supervisorWorker(supervisor, i_worker);
+        _exit(0);
+    }
+    supervisor->workers[i_worker].pid = pid;
+    return;
+}
+
+/// @brief Copies whatever the worker has reported so far into the results (and its stats into the supervisor's), and
+///        frees the ring's slots
+/// @param supervisor pointer to a supervisor struct
+/// @param i_worker which worker
+/// @param results caller owned array of n_games results, indexed by game
+void supervisorDrain(supervisor_t *supervisor, uint32_t i_worker, mind_game_result_t *results) {
+    supervisor_ring_t *ring = &supervisor->rings[i_worker];
+    supervisor_shard_t *shard = supervisor->workers[i_worker].shard;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    for (; tail < head; tail++) {
+        supervisor_slot_t *slot = &ring->slots[tail & (SUPERVISOR_RING_SIZE - 1)];
+        results[slot->i_game] = slot->result;
+        shard->next = slot->i_game + 1;
+        shard->n_retries = 0;
+        shard->results_size = slot->results_size;
+        statsMerge(supervisor->stats, slot->stats);
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    return;
+}
+
+/// @brief The worker process: plays its shard one game at a time and pushes every result into its ring. Every level goes
+///        to <results_path>.<shard>, which is flushed before a game is reported and cut back to the last reported game's
+///        size when the worker starts: the levels of a game it died in (or of a block flushed mid game) are dropped, and
+///        the game's next run writes them again. A game the checkpoint saved is resumed from the size it was saved
+///        with instead, and one that is saved but comes later in the shard is played from the start (checkpointDropGame)
+/// @param supervisor pointer to the supervisor struct (the worker's copy of it)
+/// @param i_worker which worker this is
+void supervisorWorker(supervisor_t *supervisor, uint32_t i_worker) {
+    supervisor_ring_t *ring = &supervisor->rings[i_worker];
+    supervisor_shard_t *shard = supervisor->workers[i_worker].shard;
+    checkpoint_t *checkpoint = supervisor->params.checkpoint;
+    uint64_t results_size = shard->results_size;
+    if (checkpoint != NULL && !checkpointSavedResultsSize(checkpoint, shard->next, &results_size)) {
+        checkpointDropGame(checkpoint, shard - supervisor->shards);
+    }
+    results_t results = {0};
+    if (supervisor->results_path != NULL) {
+        char path[PATH_MAX];
+        sprintf_s(path, sizeof(path), "%s.%llu", supervisor->results_path, (unsigned long long)(shard - supervisor->shards));
+        if (!resultsAppend(&results, path, supervisor->params.n_players, results_size)) {
+            _threads_api_Panik("Can't open a shard's results file!");
+        }
+        supervisor->params.results = &results;
+    }
+    mind_batch_t batch;
+    batchCreate(&batch, &supervisor->params);
+    batch.game.heartbeat_ns = &ring->heartbeat_ns; // games can take far longer than hang_ms, levels can't
+
+    for (uint64_t i_game = shard->next; i_game < shard->end; i_game++) {
+        if (getppid() != supervisor->pid) _exit(1); // nobody is listening anymore (PR_SET_PDEATHSIG should have seen to it)
+        supervisor_slot_t slot = {.i_game = i_game};
+        memset(batch.game.stats, 0, sizeof(batch.game.stats)); // so they are this game's alone (see checkpointLoadGame)
+        batchRun(&batch, supervisor->seed, i_game, 1, &slot.result);
+        if (results.file != NULL && !resultsFlush(&results)) {
+            _threads_api_Panik("Can't write a shard's results file!"); // the game is retried, and given up on in the end
+        }
+        slot.results_size = results.size;
+        memcpy(slot.stats, batch.game.stats, sizeof(slot.stats));
+
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == SUPERVISOR_RING_SIZE) {
+            if (getppid() != supervisor->pid) _exit(1);
+            SLEEP(1);
+        }
+        ring->slots[head & (SUPERVISOR_RING_SIZE - 1)] = slot;
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        atomic_store(&ring->heartbeat_ns, timeNowNs());
+    }
+
+    batchDestroy(&batch);
+    if (results.file != NULL && !resultsDestroy(&results)) {
+        _threads_api_Panik("Can't write a shard's results file!");
+    }
+    return;
+}
+
+/// @brief Commits every shard's progress, and the stats of the games it covers, to the checkpoint. Only makes sense if supervisorRun writes to checkpoint->results
+/// @param supervisor pointer to a supervisor struct
+void supervisorCheckpoint(supervisor_t *supervisor) {
+    for (uint64_t i = 0; i < supervisor->n_shards; i++) {
+        checkpointStage(supervisor->params.checkpoint, i, supervisor->shards[i].next, supervisor->shards[i].results_size);
+    }
+    checkpointCommit(supervisor->params.checkpoint, supervisor->stats);
+    return;
+}
+
+/// @brief The longest a level can take: every card dealt, played at the slowest beat of the highest level
+/// @param params the parameters the games are played with
+/// @return the length in ms, before the OS' scheduling adds its own
+uint32_t supervisorLevelMs(const mind_params_t *params) {
+    return (uint32_t)(gameDeckSize(params->n_players) * MIND_MAX_BEAT * (MIND_MAX_LEVEL / 4 + 1) * params->time_scale);
+}
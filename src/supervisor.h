@@ -0,0 +1,80 @@
+#pragma once
+
+// <signal.h> has a stack_t of its own (for sigaltstack); rename it so it doesn't clash with the cards' stack_t
+#define stack_t signal_stack_t
+#include <signal.h>
+#include <sys/wait.h>
+#undef stack_t
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <fcntl.h>
+#include <limits.h>
+#include "checkpoint.h"
+#include "results.h"
+
+#define SUPERVISOR_RING_SIZE (256) // results per worker ring, must be a power of 2
+#define SUPERVISOR_MAX_RETRIES (3) // restarts without progress before the game at fault is given up on
+
+// Runs a batch over forked worker processes, so that a crash (e.g. a _threads_api_Panik) or a hang only costs a restart.
+// Every worker streams its results through its own single producer / single consumer ring in one shared memory segment;
+// the supervisor copies them straight into the caller's array. Shards whose worker died are resumed from the first
+// game that wasn't reported, which works since every game only depends on (seed, index) - see batchGameSeed.
+// With a checkpoint (params.checkpoint), the shards' progress is committed to it every interval_ms and the run starts
+// from the last commit; the workers save their in-flight games to it, so a restarted game picks up where it was saved.
+// Every reported game comes with its stats, which are committed along with the progress. The workers write every level
+// they play to their shard's results file, and report the file's size after the game's levels with it (committed too):
+// a restarted worker cuts the file back to the last one reported, or committed after a resume, so it holds the levels of
+// the shard's reported games, once each (see supervisorWorker).
+
+typedef struct supervisor_slot_t {
+    uint64_t i_game;
+    mind_game_result_t result;
+    uint64_t results_size;                  // the shard's results file's size once the game's levels were flushed to it
+    mind_stats_t stats[MIND_MAX_LEVEL + 1]; // the game's alone
+} supervisor_slot_t;
+
+typedef struct supervisor_ring_t {
+    atomic_uint_least64_t head;             // written by the worker
+    atomic_uint_least64_t tail;             // written by the supervisor
+    atomic_uint_least64_t heartbeat_ns;     // timeNowNs of the worker's last sign of life (a level or a game finished)
+    supervisor_slot_t slots[SUPERVISOR_RING_SIZE];
+} supervisor_ring_t;
+
+typedef struct supervisor_shard_t {
+    uint64_t next;                          // first game that hasn't been reported yet
+    uint64_t end;
+    uint32_t n_retries;                     // restarts since the last reported game
+    uint64_t results_size;                  // of the shard's results file, as of the last reported game (0 = no file yet)
+} supervisor_shard_t;
+
+typedef struct supervisor_worker_t {
+    pid_t pid;                              // 0 when idle
+    supervisor_shard_t *shard;
+} supervisor_worker_t;
+
+typedef struct supervisor_t {
+    mind_params_t params;
+    uint64_t seed;
+    uint64_t n_games;
+    uint32_t hang_ms;                       // a worker that shows no sign of life for this long is killed and restarted
+    supervisor_ring_t *rings;               // shared with the workers, one ring each
+    supervisor_worker_t *workers;
+    uint32_t n_workers;
+    supervisor_shard_t *shards;
+    uint64_t n_shards;
+    uint64_t i_next_shard;                  // shards before this one were handed out already
+    uint64_t n_restarts;
+    const char *results_path;               // optional. Every shard's levels go to <results_path>.<shard>
+    mind_stats_t stats[MIND_MAX_LEVEL + 1]; // of every reported game, the checkpoint's included
+    pid_t pid;                              // the supervisor's own process, which the workers must not outlive
+} supervisor_t;
+
+bool supervisorCreate(supervisor_t *supervisor, const mind_params_t *params, uint64_t seed, uint64_t n_games,
+                      uint32_t n_workers, uint32_t shard_size, uint32_t hang_ms, const char *results_path);
+void supervisorDestroy(supervisor_t *supervisor);
+void supervisorRun(supervisor_t *supervisor, mind_game_result_t *results);
+void supervisorStart(supervisor_t *supervisor, uint32_t i_worker);
+void supervisorDrain(supervisor_t *supervisor, uint32_t i_worker, mind_game_result_t *results);
+void supervisorWorker(supervisor_t *supervisor, uint32_t i_worker);
+void supervisorCheckpoint(supervisor_t *supervisor);
+uint32_t supervisorLevelMs(const mind_params_t *params);
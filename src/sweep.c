@@ -0,0 +1,105 @@
+#include "supervisor.h"
+
+
+/// @brief Plays a batch of games over worker processes and prints a summary, with the latency and evaluation reports of
+///        every game of the batch (those of the runs it was resumed from included). With a checkpoint file the batch can
+///        be interrupted at any point: running the same command again resumes it (with the checkpoint's parameters).
+///        With a results path, every shard's levels go to <results>.<shard>, every reported game's once (query takes
+///        them as a comma separated list)
+/// @param argc 3 to 11
+/// @param argv n_games, n_workers, then optionally time_scale, max_levels, skip_above, seed, a checkpoint file (- for
+///             none), a results path (- for none), skip_sample and n_players
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <n_games> <n_workers> [time_scale=1] [max_levels=0] [skip_above=1] [seed=random] [checkpoint|-] [results|-] [skip_sample=0] [n_players=3]\n", argv[0]);
+        return 1;
+    }
+
+    mind_params_t params;
+    batchParamsDefault(&params);
+    uint64_t n_games = strtoull(argv[1], NULL, 0);
+    uint32_t n_workers = atoi(argv[2]);
+    params.time_scale = (argc > 3)? atof(argv[3]): params.time_scale;
+    params.max_levels = (argc > 4)? atoi(argv[4]): params.max_levels;
+    params.skip_above = (argc > 5)? atof(argv[5]): params.skip_above;
+    uint64_t seed = (argc > 6 && strcmp(argv[6], "random"))? strtoull(argv[6], NULL, 0): ((uint64_t)trueRand() << 32) | trueRand();
+    uint64_t shard_size = (n_games / (4 * n_workers))? n_games / (4 * n_workers): 1;
+    const char *checkpoint_path = (argc > 7 && strcmp(argv[7], "-"))? argv[7]: NULL;
+    const char *results_path = (argc > 8 && strcmp(argv[8], "-"))? argv[8]: NULL;
+    params.skip_sample = (argc > 9)? atof(argv[9]): params.skip_sample;
+    uint32_t n_players = (argc > 10)? strtoul(argv[10], NULL, 0): params.n_players;
+    if (n_players == 0 || n_players > MIND_MAX_PLAYERS) {
+        fprintf(stderr, "n_players must be 1 to %d\n", MIND_MAX_PLAYERS);
+        return 1;
+    }
+    params.n_players = n_players;
+
+    checkpoint_t checkpoint = {0};
+    mind_game_result_t *results;
+    errno = 0;
+    bool resumed = checkpoint_path != NULL && checkpointResume(&checkpoint, checkpoint_path, CHECKPOINT_INTERVAL_MS);
+    if (errno == EWOULDBLOCK) {
+        fprintf(stderr, "%s is in use by another run\n", checkpoint_path);
+        return 1;
+    }
+    if (resumed) {
+        checkpointParams(&checkpoint, &params);
+        seed = checkpoint.header->seed;
+        n_games = checkpoint.header->n_games;
+        shard_size = checkpoint.header->shard_size;
+        results = checkpoint.results;
+        printf("resuming %s (the checkpoint's parameters apply)\n", checkpoint_path);
+    } else if (checkpoint_path != NULL) {
+        if (!checkpointCreate(&checkpoint, checkpoint_path, &params, seed, n_games, shard_size, CHECKPOINT_INTERVAL_MS)) {
+            fprintf(stderr, (errno == EWOULDBLOCK)? "%s is in use by another run\n": "Can't create %s\n", checkpoint_path);
+            return 1;
+        }
+        params.checkpoint = &checkpoint;
+        results = checkpoint.results;
+    } else {
+        results = calloc(n_games, sizeof(*results));
+        if (results == NULL) {
+            fprintf(stderr, "Out of memory!");
+            exit(1);
+        }
+    }
+
+    // a worker is only considered hung once it took twice as long as any level could (and 10s more for the OS)
+    supervisor_t supervisor;
+    uint32_t hang_ms = 2 * supervisorLevelMs(&params) + 10 * 1000;
+    if (!supervisorCreate(&supervisor, &params, seed, n_games, n_workers, shard_size, hang_ms, results_path)) {
+        fprintf(stderr, "Can't set up shared memory\n");
+        return 1;
+    }
+    uint64_t n_resumed = 0;
+    for (uint64_t i = 0; i < supervisor.n_shards; i++) {
+        n_resumed += supervisor.shards[i].next - i * shard_size;
+    }
+
+    uint64_t start = timeNowNs();
+    supervisorRun(&supervisor, results);
+    double seconds = (timeNowNs() - start) / 1e9;
+
+    uint64_t n_won = 0, n_failed = 0, n_levels = 0;
+    for (uint64_t i = 0; i < n_games; i++) {
+        n_won += results[i].won;
+        n_failed += results[i].failed;
+        n_levels += results[i].n_levels_played;
+    }
+    printf("seed %llu: %llu games (%llu resumed), %llu won, %llu failed, %.2f levels per game, %llu restarts, %.2f games/s\n",
+           (unsigned long long)seed, (unsigned long long)n_games, (unsigned long long)n_resumed, (unsigned long long)n_won,
+           (unsigned long long)n_failed, (double)n_levels / n_games, (unsigned long long)supervisor.n_restarts,
+           (n_games - n_resumed) / seconds);
+    printf("\n");
+    statsLatencyReport(supervisor.stats, stdout);
+    printf("\n");
+    statsEvaluationReport(supervisor.stats, stdout);
+
+    supervisorDestroy(&supervisor);
+    if (checkpoint_path != NULL) {
+        checkpointClose(&checkpoint);
+    } else {
+        free(results);
+    }
+    return 0;
+}